@@ -0,0 +1,199 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+
+#include <linux/membarrier.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace tools {
+
+/*
+ * Production asymmetric fences.
+ *
+ * The light side is a compiler barrier: it only has to stop the compiler from
+ * moving the reader's loads/stores across it.
+ * The heavy side has to run a full memory barrier on every cpu currently
+ * running a thread of this process, which turns each light fence into a
+ * seq_cst fence "after the fact".
+ *
+ * The heavy side is picked once, at startup:
+ *   membarrier - MEMBARRIER_CMD_PRIVATE_EXPEDITED. The normal case.
+ *   mprotect   - downgrading the protection of a locked page forces a TLB
+ *                shootdown IPI to every cpu that runs this mm. Only x86
+ *                delivers the shootdown through an IPI, so only there.
+ *                For containers whose seccomp profile rejects membarrier.
+ *   seq_cst    - degraded mode: both sides are plain seq_cst fences.
+ *                The reader pays a real fence in enter()/exit().
+ *
+ * TOOLS_ASYMMETRIC_FENCE=membarrier|mprotect|seq_cst in the environment
+ * overrides the choice (if the requested strategy is available).
+ *
+ * NOTE: seq_cst is zero on purpose. Before the static initializer runs
+ * (i.e. from other static initializers) both sides behave as seq_cst fences,
+ * which is correct with any heavy side.
+ */
+
+enum class asymmetric_fence_kind : unsigned char {
+  seq_cst = 0,
+  membarrier,
+  mprotect,
+};
+
+namespace detail {
+
+inline long membarrier(int cmd) {
+  return syscall(__NR_membarrier, cmd, 0, 0);
+}
+
+[[noreturn]] inline void asymmetric_fence_fail(const char* what) {
+  std::fprintf(stderr, "tools::asymmetric_thread_fence_heavy: %s\n", what);
+  std::abort();
+}
+
+inline bool try_register_membarrier() {
+  long supported = membarrier(MEMBARRIER_CMD_QUERY);
+  if (supported < 0 || !(supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED)) {
+    return false;
+  }
+  return membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED) == 0;
+}
+
+class mprotect_fence_page {
+ public:
+  static constexpr bool kSupported =
+#if defined(__x86_64__) || defined(__i386__)
+      true;
+#else
+      false;
+#endif
+
+  static mprotect_fence_page& instance() {
+    static mprotect_fence_page res;
+    return res;
+  }
+
+  bool valid() const { return page_ != nullptr; }
+
+  void fence() {
+    std::lock_guard _{m_};
+    if (mprotect(page_, size_, PROT_READ | PROT_WRITE) != 0) {
+      asymmetric_fence_fail("mprotect(PROT_READ | PROT_WRITE) failed");
+    }
+    // The write makes sure the page is present in this cpu's TLB, so that
+    // the downgrade below has something to shoot down.
+    std::atomic_ref{*page_}.fetch_add(1, std::memory_order_relaxed);
+    if (mprotect(page_, size_, PROT_NONE) != 0) {
+      asymmetric_fence_fail("mprotect(PROT_NONE) failed");
+    }
+  }
+
+ private:
+  mprotect_fence_page() {
+    if constexpr (!kSupported) return;
+    size_ = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return;
+    if (mlock(p, size_) != 0) {
+      munmap(p, size_);
+      return;
+    }
+    // Never unmapped: a heavy fence may run during static destruction.
+    page_ = static_cast<int*>(p);
+  }
+
+  std::mutex m_;
+  int* page_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+inline bool asymmetric_fence_available(asymmetric_fence_kind kind) {
+  switch (kind) {
+    case asymmetric_fence_kind::seq_cst: return true;
+    case asymmetric_fence_kind::membarrier: return try_register_membarrier();
+    case asymmetric_fence_kind::mprotect:
+      return mprotect_fence_page::kSupported &&
+             mprotect_fence_page::instance().valid();
+  }
+  return false;
+}
+
+inline asymmetric_fence_kind select_asymmetric_fence() {
+  static constexpr const char* kNames[] = {"seq_cst", "membarrier", "mprotect"};
+
+  if (const char* env = std::getenv("TOOLS_ASYMMETRIC_FENCE")) {
+    for (std::size_t i = 0; i != std::size(kNames); ++i) {
+      auto kind = static_cast<asymmetric_fence_kind>(i);
+      if (std::strcmp(env, kNames[i]) == 0 && asymmetric_fence_available(kind)) {
+        return kind;
+      }
+    }
+  }
+
+  for (auto kind :
+       {asymmetric_fence_kind::membarrier, asymmetric_fence_kind::mprotect}) {
+    if (asymmetric_fence_available(kind)) return kind;
+  }
+  return asymmetric_fence_kind::seq_cst;
+}
+
+inline const asymmetric_fence_kind selected_asymmetric_fence =
+    select_asymmetric_fence();
+
+}  // namespace detail
+
+inline asymmetric_fence_kind asymmetric_fence_strategy() {
+  return detail::selected_asymmetric_fence;
+}
+
+inline void asymmetric_thread_fence_light() {
+  if (detail::selected_asymmetric_fence == asymmetric_fence_kind::seq_cst)
+      [[unlikely]] {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return;
+  }
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+// Individual heavy fences, callable directly for benchmarks.
+// Using one that is different from asymmetric_fence_strategy() against
+// asymmetric_thread_fence_light() is not correct (except seq_cst).
+
+inline void asymmetric_thread_fence_heavy_membarrier() {
+  if (detail::membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0) {
+    detail::asymmetric_fence_fail("MEMBARRIER_CMD_PRIVATE_EXPEDITED failed");
+  }
+}
+
+inline void asymmetric_thread_fence_heavy_mprotect() {
+  detail::mprotect_fence_page::instance().fence();
+}
+
+inline void asymmetric_thread_fence_heavy() {
+  switch (detail::selected_asymmetric_fence) {
+    case asymmetric_fence_kind::membarrier:
+      asymmetric_thread_fence_heavy_membarrier();
+      return;
+    case asymmetric_fence_kind::mprotect:
+      asymmetric_thread_fence_heavy_mprotect();
+      return;
+    case asymmetric_fence_kind::seq_cst:
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      return;
+  }
+}
+
+}  // namespace tools
@@ -18,6 +18,8 @@
 #include <memory>
 #include "shared_ptr.h"
 #else
+#include <asymmetric_thread_fence.h>
+
 #include <atomic>
 #include <functional>
 #include <memory>
@@ -38,6 +40,10 @@ void this_thread_yield(rl::debug_info_param info DEFAULTED_DEBUG_INFO) {
   rl::yield(1, info);
 }
 
+void spin_pause(rl::debug_info_param info DEFAULTED_DEBUG_INFO) {
+  rl::yield(1, info);
+}
+
 inline constexpr auto memory_order_relaxed = rl::memory_order::relaxed;
 inline constexpr auto memory_order_acquire = rl::memory_order::acquire;
 inline constexpr auto memory_order_release = rl::memory_order::release;
@@ -92,6 +98,10 @@ struct var {
 
 using rl::lock_guard;
 
+using thread_id = unsigned;
+
+inline thread_id this_thread_id() { return rl::ctx().threadx_->index_; }
+
 void asymmetric_thread_fence_light(rl::debug_info_param info DEFAULTED_DEBUG_INFO) {
   rl::atomic_thread_fence(memory_order_seq_cst, info);
 }
@@ -117,11 +127,23 @@ using atomic = std::atomic<T>;
 
 using mutex = std::mutex;
 
-template <typename... Ts>
-using lock_guard = std::lock_guard<Ts...>;
+using std::lock_guard;
+
+using thread_id = std::thread::id;
+
+inline thread_id this_thread_id() { return std::this_thread::get_id(); }
 
 void this_thread_yield() { std::this_thread::yield(); }
 
+// One iteration of a spin-wait loop: tells the cpu we are spinning.
+inline void spin_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
 void thread_fence_seq_cst() { std::atomic_thread_fence(std::memory_order_seq_cst); }
 
 inline constexpr auto memory_order_relaxed = std::memory_order::relaxed;
@@ -0,0 +1,50 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+
+#include <cstdint>
+
+namespace tools {
+
+/*
+ * What the reading subsystems (rcu_reading_subsystem, percpu and qsbr) share
+ * about their grace period sequence: 2 * completed grace periods, +1 while
+ * one is running, only advanced under the subsystem's synchronize mutex.
+ */
+
+// The gp_seq value at which a grace period that starts after the call will
+// have completed: the next one if none is running, the one after the
+// running one otherwise.
+inline std::uint64_t gp_seq_cookie(
+    const tools::atomic<std::uint64_t>& gp_seq) {
+  // Our updates are ordered before the gp_seq load, so any grace period
+  // that moves gp_seq past what we see has its heavy fence after them.
+  tools::thread_fence_seq_cst();
+  return (gp_seq.load(tools::memory_order_relaxed) + 3) & ~std::uint64_t{1};
+}
+
+// Waits for readers that don't notify: spins a little, then yields, until
+// done() holds.
+template <typename F>
+void spin_then_yield_until(F done) {
+#ifdef TOOLS_RL_TEST
+  constexpr int kSpins = 1;
+#else
+  constexpr int kSpins = 64;
+#endif
+  for (int i = 0; !done(); ++i) {
+    if (i < kSpins) {
+      tools::spin_pause();
+    } else {
+      tools::this_thread_yield();
+    }
+  }
+}
+
+}  // namespace tools
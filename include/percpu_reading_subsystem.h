@@ -0,0 +1,186 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <gp_seq.h>
+#include <utils.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#ifndef TOOLS_RL_TEST
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace tools {
+
+/*
+ * The reader-tracking half of RCU with per-cpu instead of per-thread state,
+ * the way SRCU does it.
+ *
+ * Every cpu has a lock and an unlock counter for each of two indexes.
+ * A reader picks the current index, bumps lock[index] on the cpu it is on
+ * when it enters and unlock[index] on the cpu it is on when it exits (not
+ * necessarily the same one). Readers of an index are gone once the sums of
+ * its lock and unlock counters match.
+ *
+ * synchronize() waits for the readers of the inactive index (they may have
+ * read the index just before the previous flip), flips the index and waits
+ * for the readers of the old one. It only ever reads ncpus slots, no matter
+ * how many threads read, and a tls is just the index it entered with:
+ * creating one costs nothing.
+ *
+ * The readers pay for it with an atomic increment on a shared (if mostly
+ * cpu-local) cache line on each side of the read section. Readers don't
+ * notify, synchronize() spins and then yields until they are done.
+ *
+ * The cpu comes from sched_getcpu(), which glibc serves from its rseq area.
+ * It can be stale by the time we increment, that's fine: it only costs
+ * contention. Under Relacy every enter and exit lands on the "next" cpu, so
+ * the tests always see readers migrating.
+ *
+ * Concurrent synchronize() calls share grace periods like in
+ * rcu_reading_subsystem.
+ *
+ * supports nested entering
+ */
+class percpu_reading_subsystem : tools::nomove {
+ public:
+  using counter_t = std::uint64_t;
+
+  class tls;
+
+  percpu_reading_subsystem() : percpu_reading_subsystem(default_cpus()) {}
+  explicit percpu_reading_subsystem(std::size_t cpus)
+      : cpus_(std::make_unique<cpu_slot[]>(cpus)), n_cpus_(cpus) {}
+
+  // Number of completed grace periods.
+  counter_t generation() const {
+    return gp_seq_.load(tools::memory_order_relaxed) / 2;
+  }
+
+  void synchronize();
+
+ private:
+  struct alignas(tools::cache_line_size) cpu_slot {
+    tools::atomic<counter_t> locks[2] = {0, 0};
+    tools::atomic<counter_t> unlocks[2] = {0, 0};
+  };
+
+  static std::size_t default_cpus() {
+#ifdef TOOLS_RL_TEST
+    return 2;
+#else
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    return n > 0 ? static_cast<std::size_t>(n) : 1;
+#endif
+  }
+
+  cpu_slot& this_cpu() {
+#ifdef TOOLS_RL_TEST
+    return cpus_[next_cpu_.fetch_add(1, tools::memory_order_relaxed) % n_cpus_];
+#else
+    int cpu = sched_getcpu();
+    return cpus_[cpu < 0 ? 0 : static_cast<std::size_t>(cpu) % n_cpus_];
+#endif
+  }
+
+  bool readers_done(unsigned idx);
+  void wait_for_readers(unsigned idx);
+
+  std::unique_ptr<cpu_slot[]> cpus_;
+  std::size_t n_cpus_;
+
+  tools::mutex synchronize_m_;
+  // Index readers enter with, the low bit of it.
+  tools::atomic<counter_t> flips_{0};
+  // 2 * completed grace periods, +1 while one is running.
+  tools::atomic<counter_t> gp_seq_{0};
+
+#ifdef TOOLS_RL_TEST
+  tools::atomic<std::size_t> next_cpu_{0};
+#endif
+};
+
+class percpu_reading_subsystem::tls : tools::nomove {
+ public:
+  explicit tls(percpu_reading_subsystem& s) : subsystem_(&s) {}
+
+  void enter() {
+    if (nested_readers_++) [[unlikely]] {
+      return;
+    }
+    idx_ = subsystem_->flips_.load(tools::memory_order_relaxed) & 1;
+    subsystem_->this_cpu().locks[idx_].fetch_add(1,
+                                                 tools::memory_order_relaxed);
+    tools::asymmetric_thread_fence_light();
+  }
+
+  void exit() {
+    if (--nested_readers_) [[unlikely]] {
+      return;
+    }
+    tools::asymmetric_thread_fence_light();
+    subsystem_->this_cpu().unlocks[idx_].fetch_add(
+        1, tools::memory_order_relaxed);
+  }
+
+ private:
+  percpu_reading_subsystem* subsystem_;
+  unsigned idx_ = 0;
+  std::uint32_t nested_readers_ = 0;
+};
+
+// Unlocks are summed first: a reader that we count the unlock of has its
+// lock before it, so a match can't come from a reader that is still in.
+inline bool percpu_reading_subsystem::readers_done(unsigned idx) {
+  counter_t unlocks = 0;
+  for (std::size_t i = 0; i != n_cpus_; ++i) {
+    unlocks += cpus_[i].unlocks[idx].load(tools::memory_order_relaxed);
+  }
+
+  tools::asymmetric_thread_fence_heavy();
+
+  counter_t locks = 0;
+  for (std::size_t i = 0; i != n_cpus_; ++i) {
+    locks += cpus_[i].locks[idx].load(tools::memory_order_relaxed);
+  }
+  return locks == unlocks;
+}
+
+inline void percpu_reading_subsystem::wait_for_readers(unsigned idx) {
+  tools::spin_then_yield_until([&] { return readers_done(idx); });
+}
+
+inline void percpu_reading_subsystem::synchronize() {
+  counter_t target = tools::gp_seq_cookie(gp_seq_);
+
+  tools::lock_guard _{synchronize_m_};
+  if (gp_seq_.load(tools::memory_order_relaxed) >= target) return;
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_relaxed);
+
+  tools::asymmetric_thread_fence_heavy();
+
+  counter_t flips = flips_.load(tools::memory_order_relaxed);
+  unsigned idx = static_cast<unsigned>(flips & 1);
+  wait_for_readers(idx ^ 1);
+
+  flips_.store(flips + 1, tools::memory_order_relaxed);
+  tools::asymmetric_thread_fence_heavy();
+
+  wait_for_readers(idx);
+
+  tools::asymmetric_thread_fence_heavy();
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_release);
+}
+
+}  // namespace tools
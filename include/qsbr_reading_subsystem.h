@@ -0,0 +1,146 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <gp_seq.h>
+#include <slot_list.h>
+#include <utils.h>
+
+#include <cstdint>
+
+namespace tools {
+
+/*
+ * The reader-tracking half of RCU, quiescent state based (QSBR), like
+ * liburcu-qsbr.
+ *
+ * An online thread is always reading: enter() and exit() compile to nothing.
+ * Instead the thread announces quiescent states - points where it holds no
+ * references - by calling quiescent_state(), say once per event loop
+ * iteration, and goes offline() around blocking calls. A tls is online from
+ * construction until it is destroyed or goes offline().
+ *
+ * Each tls holds the value of the global counter it last saw at a quiescent
+ * state (0: offline). synchronize() bumps the counter and waits until every
+ * tls is offline or has seen the new value. The values live in a
+ * tools::slot_list: creating and destroying a tls and checking them during a
+ * grace period take no lock.
+ *
+ * Only for threads that do call quiescent_state() regularly: a thread that
+ * stays online without it blocks every grace period. A thread must not call
+ * synchronize() while its own tls is online - it would wait for itself.
+ *
+ * Concurrent synchronize() calls share grace periods like in
+ * rcu_reading_subsystem.
+ */
+class qsbr_reading_subsystem : tools::nomove {
+ public:
+  using counter_t = std::uint64_t;
+
+  class tls;
+
+  // Number of completed grace periods.
+  counter_t generation() const {
+    return gp_seq_.load(tools::memory_order_relaxed) / 2;
+  }
+
+  void synchronize();
+
+ private:
+  bool readers_done(counter_t target);
+  void wait_for_readers(counter_t target);
+
+  // What a tls last saw at a quiescent state, 0: offline.
+  struct alignas(tools::cache_line_size) reader_slot {
+    tools::atomic<counter_t> seen{0};
+  };
+  tools::slot_list<reader_slot> readers_;
+
+  tools::mutex synchronize_m_;
+  // What readers copy at a quiescent state. Starts at 1: 0 is offline.
+  tools::atomic<counter_t> counter_{1};
+  // 2 * completed grace periods, +1 while one is running.
+  tools::atomic<counter_t> gp_seq_{0};
+};
+
+class qsbr_reading_subsystem::tls : tools::nomove {
+ public:
+  explicit tls(qsbr_reading_subsystem& s)
+      : subsystem_(&s), slot_(s.readers_) {
+    online();
+  }
+
+  // Offline before the slot goes back: the next tls gets it as is.
+  ~tls() { offline(); }
+
+  void enter() {}
+  void exit() {}
+
+  // Nothing read before is referenced after.
+  void quiescent_state() {
+    // Reads before the announcement stay before it, reads after stay after.
+    tools::asymmetric_thread_fence_light();
+    slot_->seen.store(subsystem_->counter_.load(tools::memory_order_relaxed),
+                      tools::memory_order_relaxed);
+    tools::asymmetric_thread_fence_light();
+  }
+
+  void online() {
+    slot_->seen.store(subsystem_->counter_.load(tools::memory_order_relaxed),
+                      tools::memory_order_relaxed);
+    tools::asymmetric_thread_fence_light();
+  }
+
+  void offline() {
+    tools::asymmetric_thread_fence_light();
+    slot_->seen.store(0, tools::memory_order_relaxed);
+  }
+
+ private:
+  qsbr_reading_subsystem* subsystem_;
+  tools::slot_list<reader_slot>::handle slot_;
+};
+
+// Readers can come and go (and threads with a tls online can create more)
+// while we wait: a new one starts at the current counter.
+inline bool qsbr_reading_subsystem::readers_done(counter_t target) {
+  bool done = true;
+  readers_.for_each([&](const reader_slot& r) {
+    counter_t s = r.seen.load(tools::memory_order_relaxed);
+    done &= s == 0 || s == target;
+  });
+  return done;
+}
+
+inline void qsbr_reading_subsystem::wait_for_readers(counter_t target) {
+  tools::spin_then_yield_until([&] { return readers_done(target); });
+}
+
+inline void qsbr_reading_subsystem::synchronize() {
+  counter_t target = tools::gp_seq_cookie(gp_seq_);
+
+  tools::lock_guard _{synchronize_m_};
+  if (gp_seq_.load(tools::memory_order_relaxed) >= target) return;
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_relaxed);
+
+  // A reader that sees the new counter sees whatever was unlinked before.
+  tools::asymmetric_thread_fence_heavy();
+  counter_t next = counter_.load(tools::memory_order_relaxed) + 1;
+  counter_.store(next, tools::memory_order_relaxed);
+
+  wait_for_readers(next);
+  // A reader that announced `next` or went offline is done with everything
+  // it read before.
+  tools::asymmetric_thread_fence_heavy();
+
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_release);
+}
+
+}  // namespace tools
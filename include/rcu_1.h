@@ -15,9 +15,7 @@ struct rcu_domain : tools::rcu_reading_subsystem {
   using reader_tls = tools::rcu_reading_subsystem::tls;
   struct reclaim_tls;
 
-  void barrier() { synchronize(); }
-
-
+  void barrier() { call_rcu_barrier(); }
 };
 
 struct rcu_domain::reclaim_tls : tools::nomove {
@@ -30,6 +28,12 @@ struct rcu_domain::reclaim_tls : tools::nomove {
     domain_->synchronize();
     d(x);
   }
+
+  // Doesn't wait: d(x) runs from whoever drives the domain's grace periods.
+  template <typename T, typename D = std::default_delete<T>>
+  void retire_async(T* x, D d = {}) {
+    domain_->call_rcu([x, d = std::move(d)]() mutable { d(x); });
+  }
 };
 
 }  // namespace v1
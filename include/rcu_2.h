@@ -11,8 +11,18 @@
 #include <rcu_reading_subsystem.h>
 #include <utils.h>
 
+#include <algorithm>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef TOOLS_RL_TEST
+#include <sched.h>
+#endif
 
 /*
  * Background thread reclaimer.
@@ -21,6 +31,12 @@
  * executes the tasks.
  * barrier() drains all mailboxes, synchronizes, and executes.
  *
+ * Constructed with an executor (e.g. tools::reclaim_pool::executor()), the
+ * tasks of each drained mailbox are handed to it as one batch instead of
+ * running on the calling thread. If the executor has execute_near(cpu, f),
+ * it gets the cpu the mailbox's reclaim_tls was created on. barrier() waits
+ * for every batch handed out so far, background_task() doesn't wait.
+ *
  * reader_tls and reclaim_tls are independent.
  * Most threads only need reader_tls.
  */
@@ -32,28 +48,106 @@ struct rcu_domain : tools::rcu_reading_subsystem {
   using reader_tls = tools::rcu_reading_subsystem::tls;
   struct reclaim_tls;
 
+  // retire() only queues: see tools::deferred_retire_domain.
+  static constexpr bool kDeferredRetire = true;
+
+  // The tasks of one mailbox.
+  struct batch {
+    int cpu = -1;
+    std::vector<clean_up_task> tasks;
+  };
+
+  rcu_domain() = default;
+
+  // The executor has to outlive the domain.
+  template <tools::executor Executor>
+  explicit rcu_domain(Executor ex)
+      : executor_([ex = std::move(ex)](int cpu, clean_up_task f) mutable {
+          if constexpr (requires { ex.execute_near(cpu, std::move(f)); }) {
+            ex.execute_near(cpu, std::move(f));
+          } else {
+            ex.execute(std::move(f));
+          }
+        }) {}
+
   ~rcu_domain() { barrier(); }
 
-  std::vector<clean_up_task> collect_some_clean_up_tasks();
-  std::vector<clean_up_task> collect_all_clean_up_tasks();
+  std::vector<batch> collect_some_clean_up_tasks();
+  std::vector<batch> collect_all_clean_up_tasks();
 
   void background_task() {
-    auto tasks = collect_some_clean_up_tasks();
+    auto batches = collect_some_clean_up_tasks();
     synchronize();
-    for (auto& t : tasks) t();
+    run(std::move(batches));
   }
 
   void barrier() {
-    auto tasks = collect_all_clean_up_tasks();
+    auto batches = collect_all_clean_up_tasks();
     synchronize();
-    for (auto& t : tasks) t();
+    run(std::move(batches));
+    wait_for_batches();
+  }
+
+  // Hands the mailboxes to call_rcu instead of synchronizing inline.
+  // Resumes like barrier() returns: once every batch handed out so far,
+  // background_task()'s included, is done.
+  template <tools::executor Executor = tools::inline_executor>
+  auto barrier_async(Executor ex = {}) {
+    return tools::rcu_awaiter{
+        [this](callback resume) {
+          call_rcu([this, batches = collect_all_clean_up_tasks(),
+                    resume = std::move(resume)]() mutable {
+            run(std::move(batches));
+            when_batches_done(std::move(resume));
+          });
+        },
+        std::move(ex)};
   }
 
  private:
-  using reclaim_mailbox = tools::owner_stealer<std::vector<clean_up_task>>;
+  // Most tasks a mailbox that was drained for the executor starts with room
+  // for.
+  static constexpr std::size_t kMailboxReserve = 1024;
+
+  struct reclaim_mailbox {
+    tools::owner_stealer<std::vector<clean_up_task>> tasks;
+    int cpu = -1;
+  };
+
+  // Moves a mailbox's tasks to todo.
+  void take_tasks(std::vector<batch>& todo, int cpu,
+                  std::vector<clean_up_task>& v);
+  // Runs the batches here or hands them to the executor.
+  void run(std::vector<batch> batches);
+  void wait_for_batches();
+  // f runs once no batch is running: here or on the thread of the last one.
+  void when_batches_done(callback f);
 
   tools::mutex reclaim_tls_vec_m;
   std::vector<tools::shared_ptr<reclaim_mailbox>> reclaim_mailbox_vec;
+
+  std::move_only_function<void(int, clean_up_task)> executor_;
+  // Batches handed to the executor and not done yet. Shared with them: the
+  // last one still notifies after barrier() may have returned.
+  struct batch_count {
+    tools::atomic<std::size_t> running{0};
+    tools::mutex m;
+    // when_batches_done() callbacks waiting for running to drop to 0.
+    std::vector<callback> on_done;
+
+    void finished() {
+      if (running.fetch_sub(1, tools::memory_order_acq_rel) != 1) return;
+      running.notify_all();
+      std::vector<callback> done;
+      {
+        tools::lock_guard _{m};
+        done.swap(on_done);
+      }
+      for (auto& f : done) f();
+    }
+  };
+  tools::shared_ptr<batch_count> running_batches_ =
+      tools::make_shared<batch_count>();
 };
 
 struct rcu_domain::reclaim_tls : tools::nomove {
@@ -61,28 +155,44 @@ struct rcu_domain::reclaim_tls : tools::nomove {
 
   explicit reclaim_tls(rcu_domain& d) {
     mailbox_ = tools::make_shared<reclaim_mailbox>();
+#ifndef TOOLS_RL_TEST
+    mailbox_->cpu = sched_getcpu();
+#endif
     tools::lock_guard _{d.reclaim_tls_vec_m};
     d.reclaim_mailbox_vec.push_back(mailbox_);
   }
 
   template <typename T, typename D = std::default_delete<T>>
   void retire(T* x, D d = {}) {
-    mailbox_->owner_access([&](std::vector<clean_up_task>& v) {
+    mailbox_->tasks.owner_access([&](std::vector<clean_up_task>& v) {
       v.push_back(clean_up_task([x, d = std::move(d)]() mutable { d(x); }));
     });
   }
+
+  // retire() for every pointer in xs, entering the mailbox once.
+  // Each pointer gets its own copy of d.
+  template <std::ranges::input_range R,
+            typename D = std::default_delete<
+                std::remove_pointer_t<std::ranges::range_value_t<R>>>>
+  void retire_bulk(R&& xs, D d = {}) {
+    mailbox_->tasks.owner_access([&](std::vector<clean_up_task>& v) {
+      if constexpr (std::ranges::sized_range<R>) {
+        tools::reserve_more(v, std::ranges::size(xs));
+      }
+      for (auto* x : xs) {
+        v.push_back(clean_up_task([x, d]() mutable { d(x); }));
+      }
+    });
+  }
 };
 
 // Collect from every slot once, skipping any that are currently locked.
-inline std::vector<rcu_domain::clean_up_task>
+inline std::vector<rcu_domain::batch>
 rcu_domain::collect_some_clean_up_tasks() {
-  std::vector<clean_up_task> todo;
-  auto drain = [&](auto& os) {
-    os.try_stealer_access([&](auto& v) {
-      todo.insert(todo.end(), std::make_move_iterator(v.begin()),
-                  std::make_move_iterator(v.end()));
-      v.clear();
-    });
+  std::vector<batch> todo;
+  auto drain = [&](reclaim_mailbox& m) {
+    m.tasks.try_stealer_access(
+        [&](std::vector<clean_up_task>& v) { take_tasks(todo, m.cpu, v); });
   };
   tools::lock_guard _{reclaim_tls_vec_m};
   for (auto& x : reclaim_mailbox_vec) drain(*x);
@@ -91,30 +201,91 @@ rcu_domain::collect_some_clean_up_tasks() {
 
 // Collect from every slot, retrying any that were temporarily locked.
 // Also evicts dead entries (use_count == 1 means owning reclaim_tls destroyed).
-inline std::vector<rcu_domain::clean_up_task>
+inline std::vector<rcu_domain::batch>
 rcu_domain::collect_all_clean_up_tasks() {
-  std::vector<clean_up_task> todo;
-  auto move_tasks = [&](std::vector<clean_up_task>& v) {
-    todo.insert(todo.end(), std::make_move_iterator(v.begin()),
-                std::make_move_iterator(v.end()));
-    v.clear();
+  std::vector<batch> todo;
+  auto move_tasks = [&](int cpu) {
+    return [this, &todo, cpu](std::vector<clean_up_task>& v) {
+      take_tasks(todo, cpu, v);
+    };
   };
 
   tools::lock_guard _{reclaim_tls_vec_m};
   std::vector<reclaim_mailbox*> busy;
   std::erase_if(reclaim_mailbox_vec, [&](const auto& x) {
     bool dead = x.use_count() == 1;
-    if (!x->try_stealer_access(move_tasks)) {
+    if (!x->tasks.try_stealer_access(move_tasks(x->cpu))) {
       busy.emplace_back(x.get());
       return false;
     }
     return dead;
   });
   for (auto* b : busy) {
-    b->blocking_stealer_access(move_tasks);
+    b->tasks.blocking_stealer_access(move_tasks(b->cpu));
   }
 
   return todo;
 }
 
+// Without an executor everything goes into one batch and the mailbox keeps
+// its capacity. With one the vector leaves with the batch and its memory is
+// freed with it. The mailbox gets a new one sized for what it had, up to
+// kMailboxReserve: one big update doesn't pin that much on every drain.
+inline void rcu_domain::take_tasks(std::vector<batch>& todo, int cpu,
+                                   std::vector<clean_up_task>& v) {
+  if (v.empty()) return;
+  if (!executor_) {
+    if (todo.empty()) todo.emplace_back();
+    auto& tasks = todo.front().tasks;
+    tasks.insert(tasks.end(), std::make_move_iterator(v.begin()),
+                 std::make_move_iterator(v.end()));
+    v.clear();
+    return;
+  }
+  std::vector<clean_up_task> fresh;
+  fresh.reserve(std::min(v.size(), kMailboxReserve));
+  todo.push_back({cpu, std::exchange(v, std::move(fresh))});
+}
+
+inline void rcu_domain::run(std::vector<batch> batches) {
+  if (!executor_) {
+    for (auto& b : batches) {
+      for (auto& t : b.tasks) t();
+    }
+    return;
+  }
+
+  running_batches_->running.fetch_add(batches.size(),
+                                     tools::memory_order_relaxed);
+  for (auto& b : batches) {
+    executor_(b.cpu, [count = running_batches_,
+                      tasks = std::move(b.tasks)]() mutable {
+      for (auto& t : tasks) t();
+      count->finished();
+    });
+  }
+}
+
+// Batches can take long (a big update's destructors): sleep, don't spin.
+inline void rcu_domain::wait_for_batches() {
+  auto& running = running_batches_->running;
+  for (auto n = running.load(tools::memory_order_acquire); n != 0;
+       n = running.load(tools::memory_order_acquire)) {
+    running.wait(n, tools::memory_order_relaxed);
+  }
+}
+
+inline void rcu_domain::when_batches_done(callback f) {
+  auto& count = *running_batches_;
+  {
+    tools::lock_guard _{count.m};
+    // The batch that drops running to 0 takes on_done after that, under m.
+    if (count.running.load(tools::memory_order_acquire) != 0) {
+      count.on_done.push_back(std::move(f));
+      return;
+    }
+  }
+  f();
+}
+
 }  // namespace v2
@@ -11,8 +11,11 @@
 #include <rcu_tls_reclaimer.h>
 #include <utils.h>
 
+#include <concepts>
 #include <functional>
 #include <memory>
+#include <ranges>
+#include <type_traits>
 
 /*
  * Generation-based RCU with per-thread self-cleaning reclaimers.
@@ -20,9 +23,13 @@
  * reader_tls and reclaim_tls are independent.
  * Most threads only need reader_tls.
  *
- * retire() stamps each task with the current generation.  A task at gen G is
- * safe to execute once the generation has advanced to G+2 (two full quiescent
- * cycles have elapsed).
+ * retire() stamps each task with a grace period cookie (get_state()).  A task
+ * is safe to execute once poll(cookie) holds, no matter who ran the grace
+ * period: every retire reclaims whatever became ready since, for free.
+ *
+ * retire_intrusive() does the same with an rcu_head embedded in the object
+ * instead of a task: no allocation per retire. retire_bulk() retires a range
+ * with one cookie and one trip into the reclaimer.
  *
  * garbage_collect() is the active reclaim path:
  *   1. If the domain hasn't checked for stale tasks in stale_gen_threshold
@@ -33,6 +40,14 @@
  *
  * barrier() is the blocking drain path used on shutdown or explicit flush.
  *
+ * Byte budgets: retire() takes a size hint (sizeof(T) by default),
+ * retire_bulk() one that applies to each element. A reclaim_tls whose
+ * unreclaimed hints reach retire_bytes_threshold collects like one that
+ * reaches retire_threshold tasks. The domain counts the hints of all tasks
+ * retired and not run yet if domain_bytes_threshold is set: the retire that
+ * takes that count across the threshold runs a barrier(). memory_pressure,
+ * if set, turns garbage_collect() into a barrier() while it returns true.
+ *
  * There is no background thread; garbage_collect() is called by a user thread
  * that accumulates retire_threshold unreclaimed tasks, or explicitly.
  *
@@ -49,13 +64,26 @@ struct rcu_domain : tools::rcu_reading_subsystem {
   struct config {
     std::size_t retire_threshold = 10;
     counter_t stale_gen_threshold = 10;
+    // Size hints of the unreclaimed tasks of one reclaim_tls that trigger
+    // garbage_collect(). 0: no limit.
+    std::size_t retire_bytes_threshold = 0;
+    // Size hints of the unreclaimed tasks of all reclaim_tls that trigger a
+    // barrier(). 0: no limit.
+    std::size_t domain_bytes_threshold = 0;
+    // Polled by garbage_collect(): true makes it a barrier(). Typically
+    // reads a flag set by whoever watches PSI or cgroup memory.events.
+    std::function<bool()> memory_pressure = {};
   };
 
   using reader_tls = tools::rcu_reading_subsystem::tls;
   struct reclaim_tls;
 
+  // retire() queues, synchronizes only over the thresholds: see
+  // tools::deferred_retire_domain.
+  static constexpr bool kDeferredRetire = true;
+
   rcu_domain() = default;
-  explicit rcu_domain(config cfg) : config_(cfg) {}
+  explicit rcu_domain(config cfg) : config_(std::move(cfg)) {}
 
   ~rcu_domain() { barrier(); }
 
@@ -64,12 +92,31 @@ struct rcu_domain : tools::rcu_reading_subsystem {
   void garbage_collect();
   void barrier();
 
+  // Hands the reclaimers' tasks to call_rcu instead of synchronizing inline.
+  template <tools::executor Executor = tools::inline_executor>
+  auto barrier_async(Executor ex = {}) {
+    return tools::rcu_awaiter{
+        [this](callback resume) {
+          call_rcu([tasks = steal_all_tasks(),
+                    resume = std::move(resume)]() mutable {
+            for (auto& t : tasks) t();
+            resume();
+          });
+        },
+        std::move(ex)};
+  }
+
  private:
   tools::mutex reclaimer_vec_m;
   std::vector<tools::shared_ptr<tools::rcu_tls_reclaimer>> reclaimer_vec;
   tools::atomic<counter_t> last_stale_gen{0};
+  // Size hints of the tasks retired and not run yet, if
+  // domain_bytes_threshold. Runs can be counted before their retire is:
+  // it can dip below 0 for a moment.
+  tools::atomic<std::ptrdiff_t> outstanding_bytes_{0};
 
-  void collect_stale_tasks(std::vector<clean_up_task>& out, counter_t current_gen);
+  void collect_stale_tasks(std::vector<clean_up_task>& out, counter_t completed);
+  std::vector<clean_up_task> steal_all_tasks();
 };
 
 struct rcu_domain::reclaim_tls : tools::nomove {
@@ -78,34 +125,108 @@ struct rcu_domain::reclaim_tls : tools::nomove {
 
   explicit reclaim_tls(rcu_domain& d) : domain_(&d) {
     reclaimer_ = tools::make_shared<tools::rcu_tls_reclaimer>();
+    if (d.config_.domain_bytes_threshold != 0) {
+      reclaimer_->count_bytes_in(&d.outstanding_bytes_);
+    }
     tools::lock_guard _{d.reclaimer_vec_m};
     d.reclaimer_vec.push_back(reclaimer_);
   }
 
+  // bytes: what reclaiming x frees, for the byte thresholds.
   template <typename T, typename D = std::default_delete<T>>
-  void retire(T* x, D d = {}) {
-    counter_t gen = domain_->generation();
+  void retire(T* x, D d = {}, std::size_t bytes = sizeof(T)) {
+    counter_t cookie = domain_->get_state();
     auto cnt = reclaimer_->owner_reclaim(
-        gen, clean_up_task([x, d = std::move(d)]() mutable { d(x); }));
-    if (cnt >= domain_->config_.retire_threshold) {
+        cookie, domain_->completed_state(),
+        clean_up_task([x, d = std::move(d)]() mutable { d(x); }), bytes);
+    collect_if_over_threshold(cnt, bytes);
+  }
+
+  // retire() for every pointer in xs with one cookie, entering the reclaimer
+  // once. Each pointer gets its own copy of d and counts bytes_each.
+  template <std::ranges::input_range R,
+            typename D = std::default_delete<
+                std::remove_pointer_t<std::ranges::range_value_t<R>>>>
+  void retire_bulk(
+      R&& xs, D d = {},
+      std::size_t bytes_each =
+          sizeof(std::remove_pointer_t<std::ranges::range_value_t<R>>)) {
+    counter_t cookie = domain_->get_state();
+    std::size_t n = 0;
+    auto tasks = xs | std::views::transform([&d, &n](auto* x) {
+                   ++n;
+                   return clean_up_task([x, d]() mutable { d(x); });
+                 });
+    auto cnt = reclaimer_->owner_reclaim_bulk(
+        cookie, domain_->completed_state(), tasks, bytes_each);
+    collect_if_over_threshold(cnt, n * bytes_each);
+  }
+
+  // Allocation-free retire: the object's own rcu_head is the bookkeeping.
+  // reclaim(head) runs once no reader can see the object.
+  void retire_intrusive(tools::rcu_head* head,
+                        void (*reclaim)(tools::rcu_head*),
+                        std::size_t bytes = sizeof(tools::rcu_head)) {
+    head->reclaim = reclaim;
+    counter_t cookie = domain_->get_state();
+    auto cnt = reclaimer_->owner_reclaim(cookie, domain_->completed_state(),
+                                         head, bytes);
+    collect_if_over_threshold(cnt, bytes);
+  }
+
+  // Same, for a T that derives from rcu_head: deletes x.
+  template <typename T>
+    requires std::derived_from<T, tools::rcu_head>
+  void retire_intrusive(T* x) {
+    retire_intrusive(
+        static_cast<tools::rcu_head*>(x),
+        [](tools::rcu_head* h) { delete static_cast<T*>(h); }, sizeof(T));
+  }
+
+ private:
+  void collect_if_over_threshold(std::size_t unreclaimed,
+                                 std::size_t retired_bytes) {
+    const config& cfg = domain_->config_;
+    if (cfg.domain_bytes_threshold != 0) {
+      auto bytes = static_cast<std::ptrdiff_t>(retired_bytes);
+      auto threshold = static_cast<std::ptrdiff_t>(cfg.domain_bytes_threshold);
+      std::ptrdiff_t before = domain_->outstanding_bytes_.fetch_add(
+          bytes, tools::memory_order_relaxed);
+      // Only the retire that crosses the threshold pays for the barrier.
+      if (before < threshold && before + bytes >= threshold) {
+        domain_->barrier();
+        return;
+      }
+    }
+
+    if (unreclaimed >= cfg.retire_threshold ||
+        (cfg.retire_bytes_threshold != 0 &&
+         reclaimer_->owner_pending_bytes() >= cfg.retire_bytes_threshold)) {
       domain_->garbage_collect();
-      reclaimer_->clean_ready_tasks(domain_->generation());
+      reclaimer_->clean_ready_tasks(domain_->completed_state());
     }
   }
 };
 
+// Cookies count 2 per grace period: a task is stale once it's been ready for
+// stale_gen_threshold - 1 grace periods and its owner hasn't cleaned it.
 inline void rcu_domain::collect_stale_tasks(std::vector<clean_up_task>& out,
-                                            counter_t current_gen) {
+                                            counter_t completed) {
   tools::lock_guard _{reclaimer_vec_m};
   for (auto& r : reclaimer_vec) {
     auto oldest = r->oldest_unreclaimed_hint();
-    if (oldest && *oldest + config_.stale_gen_threshold <= current_gen) {
+    if (oldest && *oldest + 2 * config_.stale_gen_threshold <= completed + 2) {
       r->try_steal_tasks(out);
     }
   }
 }
 
 inline void rcu_domain::garbage_collect() {
+  if (config_.memory_pressure && config_.memory_pressure()) {
+    barrier();
+    return;
+  }
+
   counter_t current_gen = generation();
 
   std::vector<clean_up_task> stale_tasks;
@@ -115,7 +236,7 @@ inline void rcu_domain::garbage_collect() {
     if (last_stale_gen.compare_exchange_strong(
             last_stale, current_gen, tools::memory_order_relaxed,
             tools::memory_order_relaxed)) {
-      collect_stale_tasks(stale_tasks, current_gen);
+      collect_stale_tasks(stale_tasks, completed_state());
     }
   }
 
@@ -124,24 +245,27 @@ inline void rcu_domain::garbage_collect() {
   for (auto& t : stale_tasks) t();
 }
 
-inline void rcu_domain::barrier() {
+inline std::vector<rcu_domain::clean_up_task> rcu_domain::steal_all_tasks() {
   std::vector<clean_up_task> tasks;
 
-  {
-    tools::lock_guard _{reclaimer_vec_m};
-    std::vector<tools::rcu_tls_reclaimer*> busy;
-    std::erase_if(reclaimer_vec, [&](const auto& r) {
-      bool dead = r.use_count() == 1;
-      if (!r->try_steal_tasks(tasks)) {
-        busy.emplace_back(r.get());
-        return false;
-      }
-      return dead;
-    });
-    for (auto* b : busy) {
-      b->steal_tasks_blocking(tasks);
+  tools::lock_guard _{reclaimer_vec_m};
+  std::vector<tools::rcu_tls_reclaimer*> busy;
+  std::erase_if(reclaimer_vec, [&](const auto& r) {
+    bool dead = r.use_count() == 1;
+    if (!r->try_steal_tasks(tasks)) {
+      busy.emplace_back(r.get());
+      return false;
     }
+    return dead;
+  });
+  for (auto* b : busy) {
+    b->steal_tasks_blocking(tasks);
   }
+  return tasks;
+}
+
+inline void rcu_domain::barrier() {
+  std::vector<clean_up_task> tasks = steal_all_tasks();
 
   synchronize();
 
@@ -0,0 +1,240 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <owner_stealer.h>
+#include <slot_list.h>
+#include <utils.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+ * Epoch based reclamation, three epochs, like crossbeam-epoch.
+ *
+ * A reader pins the global epoch on enter: stores it, marked pinned, in its
+ * tls. The global epoch advances from e to e + 1 only when every pinned
+ * reader is pinned at e. There is no waiting for readers anywhere: whoever
+ * tries to advance and sees a reader behind just gives up.
+ *
+ * retire() tags the task with the global epoch and puts it into the limbo
+ * bag for that epoch (epoch % 3) of its reclaim_tls. Once the global epoch
+ * is tag + 2 every reader that was pinned when the task was retired has
+ * unpinned. Reusing a bag three epochs later runs what is in it first.
+ *
+ * Every retire_threshold retires, a reclaim_tls tries to advance the epoch
+ * and runs its bags that became ready.
+ * barrier() steals every bag, then advances the epoch until they are all
+ * ready, waiting for readers if it has to.
+ *
+ * synchronize() is "advance twice", for code that wants a grace period.
+ *
+ * Readers' epochs live in a tools::slot_list: registering a reader_tls and
+ * scanning them for try_advance() take no lock.
+ *
+ * reader_tls and reclaim_tls are independent.
+ * Most threads only need reader_tls.
+ */
+
+namespace v4 {
+
+struct rcu_domain : tools::nomove {
+  using counter_t = std::uint64_t;
+  using clean_up_task = std::move_only_function<void()>;
+
+  struct config {
+    std::size_t retire_threshold = 10;
+  };
+
+  struct reader_tls;
+  struct reclaim_tls;
+
+  rcu_domain() = default;
+  explicit rcu_domain(config cfg) : config_(cfg) {}
+
+  ~rcu_domain() { barrier(); }
+
+  config config_;
+
+  counter_t epoch() const {
+    return global_epoch_.load(tools::memory_order_acquire);
+  }
+
+  // Advances the global epoch if every pinned reader has caught up with it.
+  // Returns false if one hasn't.
+  bool try_advance();
+
+  void synchronize();
+  void barrier();
+
+ private:
+  struct bag {
+    counter_t epoch = 0;
+    std::vector<clean_up_task> tasks;
+  };
+  using limbo = std::array<bag, 3>;
+  using limbo_mailbox = tools::owner_stealer<limbo>;
+
+  // The epoch retire() tags with.
+  counter_t retire_epoch() {
+    // Orders the unlink of whatever is retired before the load: a reader
+    // that pins a later epoch can't see it any more.
+    tools::thread_fence_seq_cst();
+    return epoch();
+  }
+
+  // Returns once the global epoch is at least target.
+  void advance_to(counter_t target);
+
+  tools::atomic<counter_t> global_epoch_{0};
+
+  // epoch << 1 | 1 while pinned, 0 otherwise.
+  struct alignas(tools::cache_line_size) reader_slot {
+    tools::atomic<counter_t> state{0};
+  };
+  tools::slot_list<reader_slot> readers_;
+
+  tools::mutex limbo_vec_m_;
+  std::vector<tools::shared_ptr<limbo_mailbox>> limbo_vec_;
+};
+
+struct rcu_domain::reader_tls : tools::nomove {
+  explicit reader_tls(rcu_domain& d) : domain_(&d), slot_(d.readers_) {}
+
+  void enter() {
+    if (nested_readers_++) [[unlikely]] {
+      return;
+    }
+    counter_t e = domain_->global_epoch_.load(tools::memory_order_relaxed);
+    slot_->state.store(e << 1 | 1, tools::memory_order_relaxed);
+    tools::asymmetric_thread_fence_light();
+  }
+
+  void exit() {
+    if (--nested_readers_) [[unlikely]] {
+      return;
+    }
+    tools::asymmetric_thread_fence_light();
+    slot_->state.store(0, tools::memory_order_relaxed);
+  }
+
+ private:
+  rcu_domain* domain_;
+  tools::slot_list<reader_slot>::handle slot_;
+  std::uint32_t nested_readers_ = 0;
+};
+
+struct rcu_domain::reclaim_tls : tools::nomove {
+  explicit reclaim_tls(rcu_domain& d) : domain_(&d) {
+    mailbox_ = tools::make_shared<limbo_mailbox>();
+    tools::lock_guard _{d.limbo_vec_m_};
+    d.limbo_vec_.push_back(mailbox_);
+  }
+
+  template <typename T, typename D = std::default_delete<T>>
+  void retire(T* x, D d = {}) {
+    counter_t tag = domain_->retire_epoch();
+    std::vector<clean_up_task> ready;
+    mailbox_->owner_access([&](limbo& l) {
+      bag& b = l[tag % 3];
+      if (b.epoch != tag) {
+        // Three epochs old at least: everything in it is ready.
+        ready = std::exchange(b.tasks, {});
+        b.epoch = tag;
+      }
+      b.tasks.push_back(clean_up_task([x, d = std::move(d)]() mutable { d(x); }));
+    });
+
+    if (++since_collect_ >= domain_->config_.retire_threshold) {
+      since_collect_ = 0;
+      domain_->try_advance();
+      counter_t e = domain_->epoch();
+      mailbox_->owner_access([&](limbo& l) {
+        for (bag& b : l) {
+          if (b.epoch + 2 > e) continue;
+          ready.insert(ready.end(), std::make_move_iterator(b.tasks.begin()),
+                       std::make_move_iterator(b.tasks.end()));
+          b.tasks.clear();
+        }
+      });
+    }
+
+    for (auto& t : ready) t();
+  }
+
+ private:
+  tools::shared_ptr<limbo_mailbox> mailbox_;
+  rcu_domain* domain_;
+  std::size_t since_collect_ = 0;
+};
+
+inline bool rcu_domain::try_advance() {
+  counter_t e = global_epoch_.load(tools::memory_order_acquire);
+
+  tools::asymmetric_thread_fence_heavy();
+
+  bool behind = false;
+  readers_.for_each([&](const reader_slot& r) {
+    counter_t s = r.state.load(tools::memory_order_relaxed);
+    behind |= (s & 1) && (s >> 1) != e;
+  });
+  if (behind) return false;
+
+  // Somebody else advancing from e is as good.
+  global_epoch_.compare_exchange_strong(e, e + 1, tools::memory_order_acq_rel,
+                                        tools::memory_order_relaxed);
+  return true;
+}
+
+inline void rcu_domain::advance_to(counter_t target) {
+  while (epoch() < target) {
+    if (!try_advance()) tools::this_thread_yield();
+  }
+}
+
+inline void rcu_domain::synchronize() { advance_to(retire_epoch() + 2); }
+
+inline void rcu_domain::barrier() {
+  std::vector<clean_up_task> tasks;
+  counter_t newest = 0;
+  auto move_tasks = [&](limbo& l) {
+    for (bag& b : l) {
+      if (b.tasks.empty()) continue;
+      newest = std::max(newest, b.epoch);
+      tasks.insert(tasks.end(), std::make_move_iterator(b.tasks.begin()),
+                   std::make_move_iterator(b.tasks.end()));
+      b.tasks.clear();
+    }
+  };
+
+  {
+    tools::lock_guard _{limbo_vec_m_};
+    std::vector<limbo_mailbox*> busy;
+    std::erase_if(limbo_vec_, [&](const auto& x) {
+      bool dead = x.use_count() == 1;
+      if (!x->try_stealer_access(move_tasks)) {
+        busy.emplace_back(x.get());
+        return false;
+      }
+      return dead;
+    });
+    for (auto* b : busy) {
+      b->blocking_stealer_access(move_tasks);
+    }
+  }
+
+  if (tasks.empty()) return;
+  advance_to(newest + 2);
+  for (auto& t : tasks) t();
+}
+
+}  // namespace v4
@@ -0,0 +1,211 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <owner_stealer.h>
+#include <slot_list.h>
+#include <utils.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*
+ * Hazard pointers: same reclaim_tls::retire() as the RCU domains, but
+ * readers protect individual pointers instead of entering read sections.
+ *
+ * A reader_tls has kHazards hazard slots. protect(i, src) publishes the
+ * value of src in slot i and rereads src until it is stable: after that the
+ * object stays alive until the slot is cleared or reused. The publishing
+ * side uses the light asymmetric fence, the scan the heavy one.
+ *
+ * retire() appends to the reclaim_tls's list. Once the list reaches
+ * retire_threshold + 2 * H (H: hazard slots of all readers) the owner scans:
+ * one heavy fence, a sorted snapshot of all hazards, and every task whose
+ * pointer is not in it runs. At most H stay, so at least half of the list
+ * goes each time and scanning is O(1) per retire. A list never holds much
+ * more than retire_threshold + 2 * H tasks: a stalled reader only keeps
+ * alive what its own slots point to.
+ *
+ * barrier() steals every list and scans until all of it has run, waiting
+ * for the readers still protecting something.
+ *
+ * The hazard slots live in a tools::slot_list: registering a reader_tls and
+ * collecting the hazards for a scan take no lock.
+ *
+ * Not an RCU: there is no synchronize(), reader_tls has no enter()/exit().
+ */
+
+namespace v5 {
+
+struct rcu_domain : tools::nomove {
+  using clean_up_task = std::move_only_function<void()>;
+
+  static constexpr std::size_t kHazards = 2;
+
+  struct config {
+    std::size_t retire_threshold = 10;
+  };
+
+  struct reader_tls;
+  struct reclaim_tls;
+
+  rcu_domain() = default;
+  explicit rcu_domain(config cfg) : config_(cfg) {}
+
+  ~rcu_domain() { barrier(); }
+
+  config config_;
+
+  void barrier();
+
+ private:
+  struct retired {
+    const void* ptr;
+    clean_up_task task;
+  };
+  using retired_list = std::vector<retired>;
+  using retired_mailbox = tools::owner_stealer<retired_list>;
+
+  std::size_t scan_threshold() const {
+    return config_.retire_threshold +
+           2 * kHazards * readers_count_.load(tools::memory_order_relaxed);
+  }
+  // Moves the tasks in `list` whose pointer nobody protects to the result.
+  retired_list scan(retired_list& list);
+
+  struct alignas(tools::cache_line_size) hazard_slot {
+    std::array<tools::atomic<const void*>, kHazards> hazards = {nullptr,
+                                                               nullptr};
+  };
+  tools::slot_list<hazard_slot> readers_;
+  // Live reader_tls objects, for scan_threshold().
+  tools::atomic<std::size_t> readers_count_{0};
+
+  tools::mutex retired_vec_m_;
+  std::vector<tools::shared_ptr<retired_mailbox>> retired_vec_;
+};
+
+struct rcu_domain::reader_tls : tools::nomove {
+  explicit reader_tls(rcu_domain& d) : domain_(&d), slot_(d.readers_) {
+    d.readers_count_.fetch_add(1, tools::memory_order_relaxed);
+  }
+
+  // The next reader_tls gets the slot: it can't come with hazards.
+  ~reader_tls() {
+    for (std::size_t i = 0; i != kHazards; ++i) clear(i);
+    domain_->readers_count_.fetch_sub(1, tools::memory_order_relaxed);
+  }
+
+  // The value of src, safe to dereference until slot i is cleared or reused.
+  template <typename T>
+  T* protect(std::size_t i, const tools::atomic<T*>& src) {
+    T* p = src.load(tools::memory_order_relaxed);
+    while (true) {
+      slot_->hazards[i].store(p, tools::memory_order_relaxed);
+      tools::asymmetric_thread_fence_light();
+      T* q = src.load(tools::memory_order_acquire);
+      if (q == p) return p;
+      p = q;
+    }
+  }
+
+  void clear(std::size_t i) {
+    tools::asymmetric_thread_fence_light();
+    slot_->hazards[i].store(nullptr, tools::memory_order_relaxed);
+  }
+
+ private:
+  rcu_domain* domain_;
+  tools::slot_list<hazard_slot>::handle slot_;
+};
+
+struct rcu_domain::reclaim_tls : tools::nomove {
+  explicit reclaim_tls(rcu_domain& d) : domain_(&d) {
+    mailbox_ = tools::make_shared<retired_mailbox>();
+    tools::lock_guard _{d.retired_vec_m_};
+    d.retired_vec_.push_back(mailbox_);
+  }
+
+  template <typename T, typename D = std::default_delete<T>>
+  void retire(T* x, D d = {}) {
+    std::size_t threshold = domain_->scan_threshold();
+    retired_list ready;
+    mailbox_->owner_access([&](retired_list& l) {
+      l.push_back({x, clean_up_task([x, d = std::move(d)]() mutable { d(x); })});
+      if (l.size() >= threshold) ready = domain_->scan(l);
+    });
+    // Outside of owner_access: a task can retire more.
+    for (auto& r : ready) r.task();
+  }
+
+ private:
+  tools::shared_ptr<retired_mailbox> mailbox_;
+  rcu_domain* domain_;
+};
+
+inline rcu_domain::retired_list rcu_domain::scan(retired_list& list) {
+  // Pairs with the light fence in protect(): either the reader sees the
+  // object unlinked and moves on, or we see its hazard.
+  tools::asymmetric_thread_fence_heavy();
+
+  std::vector<const void*> hazards;
+  hazards.reserve(readers_count_.load(tools::memory_order_relaxed) * kHazards);
+  readers_.for_each([&](const hazard_slot& r) {
+    for (const auto& h : r.hazards) {
+      if (auto* p = h.load(tools::memory_order_relaxed)) hazards.push_back(p);
+    }
+  });
+  std::ranges::sort(hazards);
+
+  auto protected_end = std::partition(list.begin(), list.end(), [&](auto& r) {
+    return std::ranges::binary_search(hazards, r.ptr);
+  });
+  retired_list ready;
+  ready.insert(ready.end(), std::make_move_iterator(protected_end),
+               std::make_move_iterator(list.end()));
+  list.erase(protected_end, list.end());
+  return ready;
+}
+
+inline void rcu_domain::barrier() {
+  retired_list tasks;
+  auto move_tasks = [&](retired_list& l) {
+    tasks.insert(tasks.end(), std::make_move_iterator(l.begin()),
+                 std::make_move_iterator(l.end()));
+    l.clear();
+  };
+
+  {
+    tools::lock_guard _{retired_vec_m_};
+    std::vector<retired_mailbox*> busy;
+    std::erase_if(retired_vec_, [&](const auto& x) {
+      bool dead = x.use_count() == 1;
+      if (!x->try_stealer_access(move_tasks)) {
+        busy.emplace_back(x.get());
+        return false;
+      }
+      return dead;
+    });
+    for (auto* b : busy) {
+      b->blocking_stealer_access(move_tasks);
+    }
+  }
+
+  while (true) {
+    for (auto& r : scan(tasks)) r.task();
+    if (tasks.empty()) return;
+    tools::this_thread_yield();
+  }
+}
+
+}  // namespace v5
@@ -0,0 +1,68 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <concepts>
+#include <coroutine>
+#include <functional>
+#include <utility>
+
+namespace tools {
+
+/*
+ * Coroutine side of the asynchronous grace periods.
+ *
+ * rcu_awaiter hands a "resume me" callback to `submit` (in practice:
+ * call_rcu) and suspends. Whoever runs the callback (the grace period
+ * driver) passes the resumption to the executor, so the coroutine continues
+ * where the caller wants it to and not on the driver thread.
+ *
+ * executor: anything with execute(f), f a move-only nullary callable.
+ * inline_executor resumes right on the thread that runs the callback: the
+ * coroutine then runs as part of that callback and can do whatever a callback
+ * can, including waiting for a barrier.
+ */
+
+template <typename E>
+concept executor = std::move_constructible<E> &&
+                   requires(E& e, std::move_only_function<void()> f) {
+                     e.execute(std::move(f));
+                   };
+
+struct inline_executor {
+  template <std::invocable F>
+  void execute(F&& f) {
+    std::forward<F>(f)();
+  }
+};
+
+template <typename Submit, executor Executor>
+class [[nodiscard]] rcu_awaiter {
+ public:
+  rcu_awaiter(Submit submit, Executor ex)
+      : submit_(std::move(submit)), ex_(std::move(ex)) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    // The coroutine can be resumed (and this awaiter destroyed) on another
+    // thread before submit returns: move everything out of the frame first.
+    auto submit = std::move(submit_);
+    submit(std::move_only_function<void()>(
+        [h, ex = std::move(ex_)]() mutable {
+          ex.execute(std::move_only_function<void()>([h] { h.resume(); }));
+        }));
+  }
+
+  void await_resume() const noexcept {}
+
+ private:
+  Submit submit_;
+  Executor ex_;
+};
+
+}  // namespace tools
@@ -0,0 +1,55 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <rcu_reading_subsystem.h>
+#include <utils.h>
+
+#include <stop_token>
+#include <thread>
+
+namespace tools {
+
+/*
+ * A dedicated thread that drives the asynchronous grace periods of an
+ * rcu_reading_subsystem: it sleeps until somebody calls synchronize_async()
+ * or call_rcu(), then runs one grace period for everything requested so far
+ * and the callbacks that became ready.
+ *
+ * Must be destroyed before the subsystem.
+ * On destruction runs the callbacks that are still queued.
+ *
+ * Relacy tests call process_grace_periods() from a test thread instead.
+ */
+class rcu_gp_driver : nomove {
+ public:
+  explicit rcu_gp_driver(rcu_reading_subsystem& s)
+      : subsystem_(&s), thread_([this](std::stop_token stop) { run(stop); }) {}
+
+  ~rcu_gp_driver() {
+    thread_.request_stop();
+    // Wakes the driver up.
+    (void)subsystem_->synchronize_async();
+    thread_.join();
+    subsystem_->call_rcu_barrier();
+  }
+
+ private:
+  void run(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+      auto seen = subsystem_->grace_period_requests();
+      if (!subsystem_->process_grace_periods()) {
+        subsystem_->wait_for_grace_period_request(seen);
+      }
+    }
+  }
+
+  rcu_reading_subsystem* subsystem_;
+  std::jthread thread_;
+};
+
+}  // namespace tools
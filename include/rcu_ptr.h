@@ -0,0 +1,110 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <utils.h>
+
+#include <concepts>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace tools {
+
+/*
+ * A pointer cell protected by an RCU domain: the
+ *   old = config.exchange(upd, acq_rel);
+ *   retire(tls, old);
+ * pattern as a type.
+ *
+ * load()            - the current value, for readers. Only valid inside a
+ *                     read section, and only until it ends. No refcounts:
+ *                     one acquire load (what consume ends up being anyway).
+ * store(tls, p)     - publishes p and retires the old value through tls.
+ * exchange(p)       - publishes p and hands the old value to the caller, not
+ *                     retired: readers can still see it, it has to go
+ *                     through retire() (or wait for a grace period) before
+ *                     it's freed.
+ * update(r, tls, f) - read-copy-update: publishes f(current) with a CAS loop
+ *                     and retires what it replaced. f gets a const T* (maybe
+ *                     nullptr) and returns a std::unique_ptr<T>; it can be
+ *                     called more than once when writers race. Enters a read
+ *                     section on r for each attempt.
+ *
+ * Domain has to be a deferred_retire_domain (v2, v3): retire() queues the
+ * task, it doesn't wait for readers the way v1's does. v3's retire() still
+ * runs a grace period once over its thresholds, so store() and update()
+ * belong outside of read sections there. On v2 they can be called anywhere.
+ *
+ * The cell owns its current value and deletes it on destruction, at which
+ * point there must be no readers left.
+ */
+// Domains whose reclaim_tls::retire() queues the task for later, opting in
+// with kDeferredRetire, and whose readers enter and exit read sections.
+template <typename Domain>
+concept deferred_retire_domain =
+    Domain::kDeferredRetire &&
+    requires(typename Domain::reader_tls& r, typename Domain::reclaim_tls& tls,
+             int* p) {
+      r.enter();
+      r.exit();
+      tls.retire(p);
+    };
+
+template <typename T, deferred_retire_domain Domain>
+class rcu_ptr : tools::nomove {
+ public:
+  using reader_tls = typename Domain::reader_tls;
+  using reclaim_tls = typename Domain::reclaim_tls;
+
+  rcu_ptr() = default;
+  explicit rcu_ptr(std::unique_ptr<T> p) : ptr_(p.release()) {}
+
+  ~rcu_ptr() { delete ptr_.load(tools::memory_order_relaxed); }
+
+  T* load() const { return ptr_.load(tools::memory_order_acquire); }
+
+  void store(reclaim_tls& tls, std::unique_ptr<T> p) {
+    retire(tls, ptr_.exchange(p.release(), tools::memory_order_acq_rel));
+  }
+
+  [[nodiscard]] T* exchange(std::unique_ptr<T> p) {
+    return ptr_.exchange(p.release(), tools::memory_order_acq_rel);
+  }
+
+  template <typename F>
+    requires std::same_as<std::invoke_result_t<F&, const T*>,
+                          std::unique_ptr<T>>
+  void update(reader_tls& r, reclaim_tls& tls, F f) {
+    T* old = nullptr;
+    while (true) {
+      r.enter();
+      T* cur = ptr_.load(tools::memory_order_acquire);
+      std::unique_ptr<T> next = f(static_cast<const T*>(cur));
+      bool ok = ptr_.compare_exchange_strong(cur, next.get(),
+                                             tools::memory_order_acq_rel,
+                                             tools::memory_order_relaxed);
+      r.exit();
+      if (ok) {
+        next.release();
+        old = cur;
+        break;
+      }
+    }
+    retire(tls, old);
+  }
+
+ private:
+  static void retire(reclaim_tls& tls, T* p) {
+    if (p) tls.retire(p);
+  }
+
+  tools::atomic<T*> ptr_{nullptr};
+};
+
+}  // namespace tools
@@ -7,65 +7,408 @@
 #pragma once
 
 #include <atomic_wrappers.h>
-#include <atomic_expensive_wait_cheap_notify_simple.h>
+#include <gp_seq.h>
+#include <rcu_awaitable.h>
+#include <reader_scan.h>
+#include <slot_list.h>
 #include <utils.h>
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace tools {
 
 /*
  * The reader-tracking half of RCU.
  *
- * Maintains a per-thread counter vec and a generation counter.
+ * Maintains an arena of reader slots and a generation counter.
  * synchronize() advances the generation and waits until all readers that
  * entered before the advance have exited.
  *
+ * Reader slots are owned by the subsystem and are never freed before it is.
+ * They are allocated in blocks of 64, one cache line per slot, with a bitmap
+ * of the slots in use. A tls grabs a free slot (or pushes a new block) on
+ * construction and gives it back on destruction. Both are lock free, so
+ * registering a reader never waits for a running synchronize().
+ *
+ * The slot only has what both the reader and synchronize() touch.
+ * Everything that is private to the reading thread stays in the tls.
+ * synchronize() walks a handful of blocks and reads the used slots in order.
+ * Blocks that are mostly used are scanned with a vector kernel (reader_scan.h).
+ *
+ * A lagging reader is first waited for by spinning: most read sections are
+ * short and parking costs a heavy fence and a futex round trip on both sides.
+ * The spin budget follows a running average of how long the readers we did
+ * catch by spinning took; readers we had to park for pull it down, so that
+ * long read sections don't burn cpu on every grace period.
+ * After that synchronize() parks on a two level tree: blocks are the leaves,
+ * with a bitmap of the slots still waited for, and the root counts the leaves
+ * that aren't done. A flagged reader clears its own bit on exit, the one that
+ * empties a leaf decrements the root, the one that zeroes the root wakes the
+ * grace period. K stragglers cost one sleep, and the grace period only keeps
+ * touching the root's cache line while it waits. That is all the tree buys:
+ * the scan before it and the check after the heavy fence still read every
+ * used (lagging) slot, and leaves are blocks in allocation order, not cpu or
+ * node groups.
+ *
+ * synchronize_expedited() is synchronize() that never sleeps: it spins on
+ * the lagging readers until they are gone, switches a grace period that is
+ * already parked to spinning too, and spins on the mutex behind a running
+ * grace period rather than sleeping on it. It goes through the same gp_seq_
+ * and generation, so it shares grace periods with synchronize() both ways.
+ * Long readers that want to help can poll expedite_requested() and leave
+ * their read section early.
+ *
+ * Concurrent synchronize() calls share grace periods: a caller returns as
+ * soon as one grace period that started after its call has completed, so
+ * N callers piling up on the mutex cost at most two grace periods.
+ *
+ * Grace period cookies (like get_state_synchronize_rcu & co in the kernel):
+ *   get_state()          - a cookie for "a grace period that starts after
+ *                          this call has completed". Costs a seq_cst fence.
+ *   start_grace_period() - same, and asks the driver to run that grace period.
+ *   poll(cookie)         - a load: whether that grace period has completed.
+ *   wait(cookie)         - returns right away if it has, otherwise runs
+ *                          (or joins) one grace period.
+ * completed_state() is the value poll() compares against, for code that wants
+ * to check many cookies at once (rcu_tls_reclaimer).
+ *
+ * Asynchronous grace periods:
+ *   synchronize_async() - requests a grace period and returns a completion
+ *                         handle right away.
+ *   call_rcu(cb)        - cb runs once a grace period that started after the
+ *                         call has completed.
+ *   process_grace_periods() - the driver side: runs one grace period that
+ *                         covers every request made so far, then the
+ *                         callbacks that became ready. Meant to be called in
+ *                         a loop from a dedicated thread (see rcu_gp_driver.h),
+ *                         so that request threads never wait for a grace period.
+ *   call_rcu_barrier()  - waits for every callback queued before the call to
+ *                         have executed.
+ * Ready callbacks run in queue order, one thread at a time, with no lock held:
+ * they can call_rcu(), synchronize() and call_rcu_barrier(). A thread that
+ * finds another one running callbacks leaves its ready ones to it; a barrier
+ * waits for the runner to get past them. Called from a callback, the barrier
+ * runs the ready callbacks itself - all but the ones it is called from.
+ *
+ * Coroutines (rcu_awaitable.h), resumed through the executor `ex`:
+ *   co_await grace_period(ex)  - once a grace period that started after the
+ *                                co_await has completed.
+ *   co_await barrier_async(ex) - once every callback queued before the
+ *                                co_await has executed. Domains that keep
+ *                                their own retire lists extend this.
+ * Both are call_rcu underneath, and ready callbacks run in queue order.
+ *
+ * Implicit readers (not in the Relacy build: its threads share thread_locals):
+ *   read_lock()/read_unlock(), read_guard - use a tls the calling thread
+ *   registers on first use and releases at thread exit, for code that can't
+ *   carry a tls around. The fast path is a thread_local load and a compare.
+ *   A thread remembers its last few subsystems, so alternating between them
+ *   doesn't leave the fast path.
+ *
  * supports nested entering
  * supports blocking waits for the synchronize.
  */
-class rcu_reading_subsystem {
+class rcu_reading_subsystem : tools::nomove {
  public:
   using counter_t = std::uint64_t;
 
+  using callback = std::move_only_function<void()>;
+
   class tls;
+  class completion;
+#ifndef TOOLS_RL_TEST
+  class read_guard;
+#endif
+
+  rcu_reading_subsystem() = default;
+  ~rcu_reading_subsystem();
 
   counter_t generation() const {
     return generation_.load(tools::memory_order_relaxed);
   }
 
-  void synchronize();
+  void synchronize() { wait(get_state()); }
+  void synchronize_expedited();
+  bool expedite_requested() const {
+    return expedite_.load(tools::memory_order_relaxed) != 0;
+  }
+
+  counter_t get_state();
+  counter_t start_grace_period();
+  bool poll(counter_t cookie) const { return completed_state() >= cookie; }
+  void wait(counter_t cookie);
+  counter_t completed_state() const {
+    return gp_seq_.load(tools::memory_order_acquire);
+  }
+
+  completion synchronize_async();
+  void call_rcu(callback cb);
+  void call_rcu_barrier();
+
+  template <tools::executor Executor = tools::inline_executor>
+  auto grace_period(Executor ex = {}) {
+    return tools::rcu_awaiter{
+        [this](callback resume) { call_rcu(std::move(resume)); },
+        std::move(ex)};
+  }
+
+  template <tools::executor Executor = tools::inline_executor>
+  auto barrier_async(Executor ex = {}) {
+    return grace_period(std::move(ex));
+  }
+
+#ifndef TOOLS_RL_TEST
+  // The calling thread's implicit reader for this subsystem.
+  tls& this_thread_tls() {
+    auto& last = implicit_cache_.entries.front();
+    if (last.id == id_) [[likely]] return *last.reader;
+    return this_thread_tls_slow();
+  }
+  void read_lock();
+  void read_unlock();
+#endif
+
+  bool process_grace_periods();
+  counter_t grace_period_requests() const {
+    return gp_requests_.load(tools::memory_order_relaxed);
+  }
+  // Blocks until grace_period_requests() != seen.
+  void wait_for_grace_period_request(counter_t seen) {
+    gp_requests_.wait(seen, tools::memory_order_relaxed);
+  }
 
  private:
-  tools::mutex reader_tls_vec_m;
-  std::vector<tls*> reader_tls_vec;
+  struct reader_slot;
+  // Leaf of the wait tree: flagged slots of a block that haven't been
+  // reported yet.
+  struct wait_leaf {
+    tools::atomic<std::uint64_t> pending{0};
+  };
+  using reader_list = tools::slot_list<reader_slot, wait_leaf>;
+  using reader_block = reader_list::block;
+
+  // From this many used slots it's cheaper to scan the whole block.
+#ifdef TOOLS_RL_TEST
+  static constexpr int kDenseScan = reader_block::kSize + 1;
+#else
+  static constexpr int kDenseScan = 16;
+#endif
+
+  // Bit i is set iff slot i is used by a reader that entered before desired.
+  static std::uint64_t lagging(const reader_block& b, counter_t desired);
+  // The subset of mask that is still reading.
+  static std::uint64_t still_reading(const reader_block& b,
+                                     std::uint64_t mask, counter_t desired);
+
+  // How many spins to give a lagging reader before parking.
+  // An average (1/8 weight) of the spins the readers we caught took,
+  // readers we parked for count as 0.
+  class spin_estimate {
+   public:
+#ifdef TOOLS_RL_TEST
+    static constexpr std::uint32_t kMin = 1;
+    static constexpr std::uint32_t kMax = 2;
+#else
+    static constexpr std::uint32_t kMin = 16;
+    static constexpr std::uint32_t kMax = 1024;
+#endif
+
+    std::uint32_t budget() const {
+      return std::min(kMax, 2 * (sum_ / 8) + kMin);
+    }
+
+    void caught(std::uint32_t spins) { sum_ += spins - sum_ / 8; }
+    void parked() { sum_ -= sum_ / 8; }
+
+   private:
+    // 8 * average, to not lose the small ones to rounding.
+    std::uint32_t sum_ = 0;
+  };
+
+#ifndef TOOLS_RL_TEST
+  struct implicit_lifetime;
+  struct implicit_registry;
+
+  // Last subsystems this thread used implicitly, most recent first. Keyed by
+  // id_, not by address: a new subsystem can be constructed where an old one
+  // was.
+  struct implicit_cache {
+    struct entry {
+      std::uint64_t id = 0;
+      tls* reader = nullptr;
+    };
+    std::array<entry, 4> entries;
+
+    void push_front(entry e);
+  };
+  static thread_local implicit_cache implicit_cache_;
+  static inline std::atomic<std::uint64_t> next_id_{1};
+
+  tls& this_thread_tls_slow();
+  tls& register_this_thread();
+#endif
+
+  void request_grace_period(counter_t target);
+  // Requires synchronize_m_.
+  void run_grace_period();
+  // Slots of one block that entered before the generation we wait for.
+  struct lagging_readers {
+    reader_block* block;
+    std::uint64_t mask;
+  };
+  // Requires synchronize_m_. Returns once none of `waiting` is reading
+  // with a generation below desired.
+  void wait_for_readers(std::vector<lagging_readers>& waiting,
+                        counter_t desired);
+  // Clears a flagged slot from its leaf, whoever took the flag.
+  void report_quiescent(reader_block& b, const reader_slot& s);
+  // Requires callbacks_m_. Moves the callbacks whose grace period has
+  // completed to ready_.
+  void collect_ready_callbacks();
+  bool run_ready_callbacks();
+  // Requires being the runner. Runs ready_ until it's empty.
+  bool drain_ready_callbacks();
+
+  tools::mutex synchronize_m_;
+  reader_list readers_;
+  // What readers stamp their slots with. Advanced at the start of each
+  // grace period.
   tools::atomic<counter_t> generation_{1};
+  // Grace period sequence: 2 * completed grace periods, +1 while one is
+  // running. Only changes under synchronize_m_.
+  tools::atomic<counter_t> gp_seq_{0};
+  // Only used under synchronize_m_.
+  spin_estimate spin_;
+  // Root of the wait tree. Low half: blocks with slots a parked grace
+  // period still waits for. High half: bumped by synchronize_expedited()
+  // to wake the parked grace period.
+  tools::atomic<std::uint64_t> pending_blocks_{0};
+  static constexpr std::uint64_t kPendingBlocks = 0xffff'ffff;
+  static constexpr std::uint64_t kExpediteWakeup = kPendingBlocks + 1;
+  // Number of synchronize_expedited() callers waiting.
+  tools::atomic<std::uint32_t> expedite_{0};
+
+  // Highest gp_seq_ target anybody asked the driver for.
+  tools::atomic<counter_t> gp_requested_{0};
+  // Bumped on every request, the driver sleeps on it.
+  tools::atomic<counter_t> gp_requests_{0};
+
+  tools::mutex callbacks_m_;
+  // Waiting for their grace period, cookies increasing, so the ready ones
+  // are at the front. Under callbacks_m_ like the rest.
+  std::deque<std::pair<counter_t, callback>> callbacks_;
+  std::deque<callback> ready_;
+  // Callbacks ever moved to ready_ and taken from it.
+  counter_t ready_total_ = 0;
+  counter_t taken_total_ = 0;
+  // One thread runs callbacks at a time, depth_ > 0 while it's in one.
+  bool running_ = false;
+  tools::thread_id runner_{};
+  std::uint32_t depth_ = 0;
+  // The first executed_ callbacks moved to ready_ have run.
+  // call_rcu_barrier() waits on it.
+  tools::atomic<counter_t> executed_{0};
+
+#ifndef TOOLS_RL_TEST
+  const std::uint64_t id_ = next_id_.fetch_add(1, std::memory_order_relaxed);
+  // Shared with the threads that registered implicitly.
+  std::shared_ptr<implicit_lifetime> implicit_ =
+      std::make_shared<implicit_lifetime>();
+#endif
+};
+
+class rcu_reading_subsystem::completion {
+ public:
+  bool ready() const { return subsystem_->poll(target_); }
+
+  // Doesn't run the grace period: needs somebody driving them.
+
+  void wait() const {
+    counter_t cur = subsystem_->gp_seq_.load(tools::memory_order_acquire);
+    while (cur < target_) {
+      subsystem_->gp_seq_.wait(cur, tools::memory_order_relaxed);
+      cur = subsystem_->gp_seq_.load(tools::memory_order_acquire);
+    }
+  }
+
+ private:
+  friend class rcu_reading_subsystem;
+
+  completion(rcu_reading_subsystem* s, counter_t target)
+      : subsystem_(s), target_(target) {}
+
+  rcu_reading_subsystem* subsystem_;
+  counter_t target_;
 };
 
+struct alignas(tools::cache_line_size) rcu_reading_subsystem::reader_slot
+    : tools::nomove {
+  bool is_reading(counter_t desired) const {
+    counter_t cur = counter.load(tools::memory_order_relaxed);
+    return 0 < cur && cur < desired;
+  }
+
+  tools::atomic<counter_t> counter{0};
+  // synchronize() is parked until this reader exits. Taken (exchanged to
+  // false) exactly once, by the reader or by synchronize(), and whoever takes
+  // it reports the slot.
+  tools::atomic<bool> waiting{false};
+};
+
+inline std::uint64_t rcu_reading_subsystem::lagging(const reader_block& b,
+                                                    counter_t desired) {
+  std::uint64_t used = b.in_use.load(tools::memory_order_relaxed);
+  if (std::popcount(used) >= kDenseScan) {
+    return used & tools::lagging_readers_mask_simd<sizeof(reader_slot)>(
+                      &b.slots[0].counter, reader_block::kSize, desired);
+  }
+  std::uint64_t res = 0;
+  for (; used; used &= used - 1) {
+    int i = std::countr_zero(used);
+    if (b.slots[i].is_reading(desired)) res |= std::uint64_t{1} << i;
+  }
+  return res;
+}
+
+inline std::uint64_t rcu_reading_subsystem::still_reading(
+    const reader_block& b, std::uint64_t mask, counter_t desired) {
+  std::uint64_t res = mask;
+  for (; mask; mask &= mask - 1) {
+    int i = std::countr_zero(mask);
+    if (!b.slots[i].is_reading(desired)) res &= ~(std::uint64_t{1} << i);
+  }
+  return res;
+}
+
 class rcu_reading_subsystem::tls : tools::nomove {
  public:
   explicit tls(rcu_reading_subsystem& s) : subsystem_(&s) {
-    tools::lock_guard _{subsystem_->reader_tls_vec_m};
-    subsystem_->reader_tls_vec.push_back(this);
+    std::tie(block_, slot_) = s.readers_.acquire();
   }
 
   ~tls() {
-    tools::lock_guard _{subsystem_->reader_tls_vec_m};
-    std::iter_swap(std::ranges::find(subsystem_->reader_tls_vec, this),
-                   std::prev(subsystem_->reader_tls_vec.end()));
-    subsystem_->reader_tls_vec.pop_back();
+    if (block_) block_->release(slot_);
   }
 
   void enter() {
     counter_t g = subsystem_->generation_.load(tools::memory_order_relaxed);
-    counter_t cur = counter_.load(tools::memory_order_relaxed);
+    counter_t cur = slot_->counter.load(tools::memory_order_relaxed);
 
     if (cur) [[unlikely]] {
       ++nested_readers_;
       return;
     }
 
-    counter_.store(g, tools::memory_order_relaxed);
+    slot_->counter.store(g, tools::memory_order_relaxed);
     tools::asymmetric_thread_fence_light();
   }
   void exit() {
@@ -76,57 +419,421 @@ class rcu_reading_subsystem::tls : tools::nomove {
 
     // This light fence is to communicate with rcu::sync.
     tools::asymmetric_thread_fence_light();
-    counter_.store(0, tools::memory_order_relaxed);
+    slot_->counter.store(0, tools::memory_order_relaxed);
+
+    // Pairs with the heavy fence in wait_for_readers().
+    tools::asymmetric_thread_fence_light();
+    if (slot_->waiting.load(tools::memory_order_relaxed)) [[unlikely]] {
+      if (slot_->waiting.exchange(false, tools::memory_order_acq_rel)) {
+        subsystem_->report_quiescent(*block_, *slot_);
+      }
+    }
+  }
+
+ private:
+  friend class rcu_reading_subsystem;
+
+  rcu_reading_subsystem* subsystem_;
+  // nullptr once the subsystem is gone (implicit readers only).
+  reader_block* block_;
+  reader_slot* slot_;
+  std::uint32_t nested_readers_ = 0;
+};
+
+#ifndef TOOLS_RL_TEST
 
+inline thread_local rcu_reading_subsystem::implicit_cache
+    rcu_reading_subsystem::implicit_cache_;
 
-    waiter_.notify_one();
+class rcu_reading_subsystem::read_guard : tools::nomove {
+ public:
+  explicit read_guard(rcu_reading_subsystem& s) : tls_(&s.this_thread_tls()) {
+    tls_->enter();
   }
+  ~read_guard() { tls_->exit(); }
 
-  bool is_reading(counter_t desired) const {
-    counter_t cur = counter_.load(tools::memory_order_relaxed);
-    return 0 < cur && cur < desired;
+ private:
+  tls* tls_;
+};
+
+// Whether implicit tls objects can still release their slots.
+struct rcu_reading_subsystem::implicit_lifetime {
+  std::mutex m;
+  bool alive = true;
+};
+
+// The implicit tls objects of one thread, released at its exit.
+struct rcu_reading_subsystem::implicit_registry : tools::nomove {
+  struct entry {
+    std::uint64_t id;
+    std::shared_ptr<implicit_lifetime> lifetime;
+    std::unique_ptr<tls> reader;
+  };
+
+  ~implicit_registry() {
+    implicit_cache_ = {};
+    for (auto& e : entries) release(e, /*only_dead*/ false);
   }
 
-  // At most one waiter
-  void wait(counter_t desired) {
-    counter_t first_seen = counter_.load(tools::memory_order_relaxed);
-    if (first_seen == 0 || first_seen >= desired) {
-      return;
+  // Releases the tls objects of dead subsystems, once entries has doubled
+  // since the last sweep: not every registration takes every mutex.
+  void sweep() {
+    if (entries.size() < sweep_at) return;
+    std::erase_if(entries,
+                  [](auto& e) { return release(e, /*only_dead*/ true); });
+    implicit_cache_ = {};
+    sweep_at = std::max(kMinSweep, 2 * entries.size());
+  }
+
+  static bool release(entry& e, bool only_dead) {
+    std::lock_guard _{e.lifetime->m};
+    if (!e.lifetime->alive) {
+      // The slots went with the subsystem.
+      e.reader->block_ = nullptr;
+    } else if (only_dead) {
+      return false;
     }
-    waiter_.wait(first_seen);
+    e.reader.reset();
+    return true;
   }
 
+  std::vector<entry> entries;
+
  private:
-  friend class rcu_reading_subsystem;
+  static constexpr std::size_t kMinSweep = 8;
+  std::size_t sweep_at = kMinSweep;
+};
 
-  // There is a false sharing in theory here but
-  // this is not the case where we expect it to be relevant.
-  tools::atomic<counter_t> counter_{0};
-  std::uint32_t nested_readers_ = 0;
-  tools::atomic_expensive_wait_cheap_notify_simple<counter_t> waiter_{&counter_};
+#endif
 
-  rcu_reading_subsystem* subsystem_;
-};
+inline rcu_reading_subsystem::~rcu_reading_subsystem() {
+  bool has_callbacks = false;
+  {
+    tools::lock_guard _{callbacks_m_};
+    has_callbacks = !callbacks_.empty() || !ready_.empty();
+  }
+  if (has_callbacks) call_rcu_barrier();
 
-inline void rcu_reading_subsystem::synchronize() {
-  tools::asymmetric_thread_fence_heavy();
+#ifndef TOOLS_RL_TEST
+  {
+    std::lock_guard _{implicit_->m};
+    implicit_->alive = false;
+  }
+#endif
+}
+
+
+#ifndef TOOLS_RL_TEST
+
+inline void rcu_reading_subsystem::read_lock() { this_thread_tls().enter(); }
+inline void rcu_reading_subsystem::read_unlock() { this_thread_tls().exit(); }
+
+inline void rcu_reading_subsystem::implicit_cache::push_front(entry e) {
+  std::shift_right(entries.begin(), entries.end(), 1);
+  entries.front() = e;
+}
+
+inline rcu_reading_subsystem::tls&
+rcu_reading_subsystem::this_thread_tls_slow() {
+  auto& cached = implicit_cache_.entries;
+  auto it = std::ranges::find(cached, id_, &implicit_cache::entry::id);
+  if (it == cached.end()) return register_this_thread();
+  std::rotate(cached.begin(), it, std::next(it));
+  return *cached.front().reader;
+}
+
+inline rcu_reading_subsystem::tls&
+rcu_reading_subsystem::register_this_thread() {
+  static thread_local implicit_registry registry;
+
+  auto it = std::ranges::find(registry.entries, id_,
+                              &implicit_registry::entry::id);
+  if (it == registry.entries.end()) {
+    registry.sweep();
+    registry.entries.push_back({id_, implicit_, std::make_unique<tls>(*this)});
+    it = std::prev(registry.entries.end());
+  }
+  implicit_cache_.push_front({id_, it->reader.get()});
+  return *it->reader;
+}
+
+#endif
+
+inline rcu_reading_subsystem::counter_t rcu_reading_subsystem::get_state() {
+  return tools::gp_seq_cookie(gp_seq_);
+}
+
+inline rcu_reading_subsystem::counter_t
+rcu_reading_subsystem::start_grace_period() {
+  counter_t cookie = get_state();
+  request_grace_period(cookie);
+  return cookie;
+}
+
+inline void rcu_reading_subsystem::wait(counter_t cookie) {
+  if (poll(cookie)) return;
+
+  tools::lock_guard _{synchronize_m_};
+  // A cookie is at most two ahead of an idle gp_seq_, one grace period
+  // is enough.
+  if (gp_seq_.load(tools::memory_order_relaxed) >= cookie) return;
+  run_grace_period();
+}
+
+inline void rcu_reading_subsystem::synchronize_expedited() {
+  counter_t cookie = get_state();
+  if (poll(cookie)) return;
+
+  expedite_.fetch_add(1, tools::memory_order_relaxed);
+  // Wakes a grace period parked in wait_for_readers(), which sees expedite_
+  // through this release.
+  pending_blocks_.fetch_add(kExpediteWakeup, tools::memory_order_release);
+  pending_blocks_.notify_one();
+  tools::scope_exit _{
+      [&] { expedite_.fetch_sub(1, tools::memory_order_relaxed); }};
 
-  tools::lock_guard _{reader_tls_vec_m};
+  // Not wait(cookie): that would sleep on synchronize_m_ behind a running
+  // grace period, which spins now and either covers the cookie or is done
+  // soon.
+  while (!poll(cookie)) {
+    if (synchronize_m_.try_lock()) {
+      tools::scope_exit unlock{[&] { synchronize_m_.unlock(); }};
+      if (gp_seq_.load(tools::memory_order_relaxed) < cookie) {
+        run_grace_period();
+      }
+      return;
+    }
+    tools::spin_pause();
+  }
+}
+
+inline void rcu_reading_subsystem::run_grace_period() {
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_relaxed);
+
+  tools::asymmetric_thread_fence_heavy();
 
   counter_t desired = generation_.load(tools::memory_order_relaxed) + 1;
   generation_.store(desired, tools::memory_order_relaxed);
 
-  std::vector<tls*> waiting;
-  waiting.reserve(reader_tls_vec.size());
-  std::ranges::copy_if(
-      reader_tls_vec, std::back_inserter(waiting),
-      [desired](const tls* x) { return x->is_reading(desired); });
+  std::vector<lagging_readers> waiting;
+  for (auto* b = readers_.head(); b; b = b->next) {
+    if (auto mask = lagging(*b, desired)) waiting.push_back({b, mask});
+  }
+
+  wait_for_readers(waiting, desired);
 
-  for (auto* tls : waiting) {
-    tls->wait(desired);
+  tools::asymmetric_thread_fence_heavy();
+
+  gp_seq_.store(gp_seq_.load(tools::memory_order_relaxed) + 1,
+                tools::memory_order_release);
+  gp_seq_.notify_all();
+}
+
+inline void rcu_reading_subsystem::wait_for_readers(
+    std::vector<lagging_readers>& waiting, counter_t desired) {
+  // Expedited grace periods spin for as long as it takes, and are not
+  // what the estimate is about.
+  bool learn = !expedite_requested();
+  std::uint32_t budget = spin_.budget();
+  for (std::uint32_t i = 1;
+       !waiting.empty() && (i <= budget || expedite_requested()); ++i) {
+    tools::spin_pause();
+    std::erase_if(waiting, [&](lagging_readers& w) {
+      std::uint64_t still = still_reading(*w.block, w.mask, desired);
+      if (learn) {
+        for (int n = std::popcount(w.mask & ~still); n; --n) spin_.caught(i);
+      }
+      w.mask = still;
+      return !still;
+    });
+  }
+  if (waiting.empty()) return;
+
+  // Build the tree before raising any flag: a reader that takes its flag
+  // goes straight to the leaf and the root.
+  // The low half is 0 between grace periods, adding keeps the high half.
+  pending_blocks_.fetch_add(waiting.size(), tools::memory_order_relaxed);
+  for (auto& w : waiting) {
+    w.block->extra.pending.store(w.mask, tools::memory_order_relaxed);
+  }
+  for (auto& w : waiting) {
+    for (auto m = w.mask; m; m &= m - 1) {
+      if (learn) spin_.parked();
+      w.block->slots[std::countr_zero(m)].waiting.store(
+          true, tools::memory_order_release);
+    }
   }
 
+  // Either a reader sees its flag on exit, or we see it gone here.
   tools::asymmetric_thread_fence_heavy();
+
+  for (auto& w : waiting) {
+    for (auto m = w.mask; m; m &= m - 1) {
+      auto& s = w.block->slots[std::countr_zero(m)];
+      if (!s.is_reading(desired) &&
+          s.waiting.exchange(false, tools::memory_order_acq_rel)) {
+        report_quiescent(*w.block, s);
+      }
+    }
+  }
+
+  // Every flag gets taken and reported exactly once, so once the root is
+  // zero no reader of this grace period touches the tree any more.
+  for (auto v = pending_blocks_.load(tools::memory_order_acquire);
+       v & kPendingBlocks; v = pending_blocks_.load(tools::memory_order_acquire)) {
+    if (expedite_requested()) {
+      tools::spin_pause();
+    } else {
+      pending_blocks_.wait(v, tools::memory_order_relaxed);
+    }
+  }
+}
+
+inline void rcu_reading_subsystem::report_quiescent(reader_block& b,
+                                                    const reader_slot& s) {
+  auto bit = b.bit_of(s);
+  if (b.extra.pending.fetch_and(~bit, tools::memory_order_acq_rel) != bit) {
+    return;
+  }
+  auto old = pending_blocks_.fetch_sub(1, tools::memory_order_acq_rel);
+  if ((old & kPendingBlocks) == 1) {
+    pending_blocks_.notify_one();
+  }
+}
+
+inline void rcu_reading_subsystem::request_grace_period(counter_t target) {
+  counter_t cur = gp_requested_.load(tools::memory_order_relaxed);
+  while (cur < target &&
+         !gp_requested_.compare_exchange_weak(cur, target,
+                                              tools::memory_order_relaxed,
+                                              tools::memory_order_relaxed)) {
+  }
+  gp_requests_.fetch_add(1, tools::memory_order_release);
+  gp_requests_.notify_one();
+}
+
+inline rcu_reading_subsystem::completion
+rcu_reading_subsystem::synchronize_async() {
+  return completion{this, start_grace_period()};
+}
+
+inline void rcu_reading_subsystem::call_rcu(callback cb) {
+  counter_t target = get_state();
+  {
+    tools::lock_guard _{callbacks_m_};
+    // A concurrent call_rcu can get a newer cookie and get here first.
+    // Waiting for its grace period as well is always safe and keeps the
+    // cookies sorted.
+    if (!callbacks_.empty()) {
+      target = std::max(target, callbacks_.back().first);
+    }
+    callbacks_.emplace_back(target, std::move(cb));
+  }
+  request_grace_period(target);
+}
+
+inline void rcu_reading_subsystem::collect_ready_callbacks() {
+  counter_t done = completed_state();
+  while (!callbacks_.empty() && callbacks_.front().first <= done) {
+    ready_.push_back(std::move(callbacks_.front().second));
+    callbacks_.pop_front();
+    ++ready_total_;
+  }
+}
+
+inline bool rcu_reading_subsystem::run_ready_callbacks() {
+  {
+    tools::lock_guard _{callbacks_m_};
+    collect_ready_callbacks();
+    // The runner looks for ready callbacks once more before it stops.
+    // Also the case of being called from a callback.
+    if (running_ || ready_.empty()) return false;
+    running_ = true;
+    runner_ = tools::this_thread_id();
+  }
+  return drain_ready_callbacks();
+}
+
+inline bool rcu_reading_subsystem::drain_ready_callbacks() {
+  bool res = false;
+  while (true) {
+    callback cb;
+    {
+      tools::lock_guard _{callbacks_m_};
+      if (ready_.empty()) collect_ready_callbacks();
+      if (ready_.empty()) {
+        // A nested drain leaves stopping to the outermost one.
+        if (depth_ == 0) running_ = false;
+        return res;
+      }
+      cb = std::move(ready_.front());
+      ready_.pop_front();
+      ++taken_total_;
+      ++depth_;
+    }
+
+    cb();
+    res = true;
+
+    counter_t executed = 0;
+    {
+      tools::lock_guard _{callbacks_m_};
+      // Everything taken while cb ran was run inside of it and is done.
+      if (--depth_ == 0) executed = taken_total_;
+    }
+    if (executed) {
+      executed_.store(executed, tools::memory_order_release);
+      executed_.notify_all();
+    }
+  }
+}
+
+inline bool rcu_reading_subsystem::process_grace_periods() {
+  bool res = false;
+  counter_t requested = gp_requested_.load(tools::memory_order_relaxed);
+  if (gp_seq_.load(tools::memory_order_relaxed) < requested) {
+    tools::lock_guard _{synchronize_m_};
+    // Every target is at most two ahead of an idle gp_seq_,
+    // so one grace period covers all the requests we've seen.
+    if (gp_seq_.load(tools::memory_order_relaxed) < requested) {
+      run_grace_period();
+    }
+    res = true;
+  }
+  return run_ready_callbacks() || res;
+}
+
+inline void rcu_reading_subsystem::call_rcu_barrier() {
+  // Every callback queued before this point is ready after this.
+  synchronize();
+
+  counter_t target = 0;
+  bool other_runner = false;
+  {
+    tools::lock_guard _{callbacks_m_};
+    collect_ready_callbacks();
+    target = ready_total_;
+    if (!running_) {
+      running_ = true;
+      runner_ = tools::this_thread_id();
+    } else {
+      other_runner = runner_ != tools::this_thread_id();
+    }
+  }
+
+  // Either nobody runs callbacks or we are called from one:
+  // run them ourselves.
+  if (!other_runner) {
+    drain_ready_callbacks();
+    return;
+  }
+
+  // The runner doesn't stop before it has taken ours.
+  for (counter_t cur = executed_.load(tools::memory_order_acquire);
+       cur < target; cur = executed_.load(tools::memory_order_acquire)) {
+    executed_.wait(cur, tools::memory_order_relaxed);
+  }
 }
 
 }  // namespace tools
@@ -9,10 +9,18 @@
 
 #include <atomic_wrappers.h>
 #include <owner_stealer.h>
+#include <utils.h>
 
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
 #include <functional>
 #include <limits>
+#include <iterator>
 #include <optional>
+#include <ranges>
+#include <utility>
 #include <vector>
 
 namespace tools {
@@ -21,9 +29,28 @@ namespace tools {
  * rcu tls collection of tasks to reclaim.
  *
  * Owner adds tasks to the list, using owner_reclaim.
- * He also passes the current generation of the rcu. Anything that is 2 or more
- * generations ago gets executed (generation is increasing in the beginning of a
- * sync by 1).
+ * Each task comes with a grace period cookie
+ * (rcu_reading_subsystem::get_state()). The owner also passes the completed
+ * state of the rcu (rcu_reading_subsystem::completed_state()). Any task whose
+ * cookie is <= the completed state gets executed: its grace period has
+ * elapsed, whoever ran it. Reclaiming never triggers a grace period.
+ *
+ * Tasks are grouped by cookie into a ring of kBuckets buckets, oldest first.
+ * Pending cookies span at most two grace periods (completed + 2 and
+ * completed + 4), so the ring rarely fills up. When it does, the newest
+ * bucket takes the newer cookie: running its tasks a bit later is always
+ * safe. Cleaning runs and empties whole buckets from the front; nothing is
+ * shifted and the buckets keep their capacity.
+ *
+ * owner_reclaim_bulk takes a range of tasks (or rcu_head*) with one cookie
+ * and enters the owner section once for all of them.
+ *
+ * Tasks can carry a size hint in bytes. owner_pending_bytes() is the sum of
+ * the hints of the owner's unreclaimed tasks as of its last owner_reclaim /
+ * clean_ready_tasks (a steal since doesn't lower it). With
+ * count_bytes_in(c), the hints of tasks that run are subtracted from *c
+ * (stolen ones: by a last task after them), so that whoever adds what it
+ * retires to *c has a count of the outstanding bytes.
  *
  * owner_reclaim returns the number of the unreclaimed tasks. If it's too much,
  * the user might trigger sync / and call clean_ready_tasks (part of
@@ -38,17 +65,40 @@ namespace tools {
  *
  * rcu_barrier sometimes uses steal_tasks_blocking.
  *
- * try_steal_tasks and steal_tasks_blocking don't care for generation, since
+ * try_steal_tasks and steal_tasks_blocking don't care for cookies, since
  * they are doing a sync anyways.
+ *
+ * Intrusive tasks: owner_reclaim(cookie, completed, rcu_head*) chains an
+ * rcu_head embedded in the retired object into the bucket instead of storing
+ * a task, so retiring allocates nothing. A steal hands over all the heads as
+ * one task.
  */
 
+// The hook for intrusive retire, like the kernel's struct rcu_head: embed it
+// in the object. reclaim gets the head back once it is safe.
+struct rcu_head {
+  rcu_head* next = nullptr;
+  void (*reclaim)(rcu_head*) = nullptr;
+};
+
 class rcu_tls_reclaimer {
  public:
   using counter_t = std::uint64_t;
   using task = std::move_only_function<void()>;
 
-  std::size_t owner_reclaim(counter_t current_gen, task t);
-  std::size_t clean_ready_tasks(counter_t current_gen);
+  std::size_t owner_reclaim(counter_t cookie, counter_t completed, task t,
+                            std::size_t bytes = 0);
+  std::size_t owner_reclaim(counter_t cookie, counter_t completed,
+                            rcu_head* head, std::size_t bytes = 0);
+  // bytes_each: the size hint of every element.
+  template <std::ranges::input_range R>
+  std::size_t owner_reclaim_bulk(counter_t cookie, counter_t completed,
+                                 R&& tasks, std::size_t bytes_each = 0);
+  std::size_t clean_ready_tasks(counter_t completed);
+
+  std::size_t owner_pending_bytes() const { return owner_bytes_; }
+  // Before the first owner_reclaim.
+  void count_bytes_in(tools::atomic<std::ptrdiff_t>* c) { live_bytes_ = c; }
 
   std::optional<counter_t> oldest_unreclaimed_hint() const;
 
@@ -56,45 +106,184 @@ class rcu_tls_reclaimer {
   void steal_tasks_blocking(std::vector<task>& here);
 
  private:
-  using task_entry = std::pair<counter_t, task>;
+  static constexpr std::size_t kBuckets = 3;
 
-  void do_clean(std::vector<task_entry>& v, counter_t current_gen);
-  void do_steal_tasks(std::vector<task_entry>& v, std::vector<task>& here);
+  // Everything retired with one cookie.
+  struct bucket {
+    counter_t cookie = 0;
+    std::vector<task> tasks;
+    // Intrusive tasks, first to last.
+    rcu_head* first = nullptr;
+    rcu_head* last = nullptr;
+    std::size_t n_heads = 0;
+    // Sum of the size hints.
+    std::size_t bytes = 0;
+
+    std::size_t size() const { return tasks.size() + n_heads; }
+    void push(task t) { tasks.push_back(std::move(t)); }
+    void push(rcu_head* h);
+    // Runs and forgets everything, keeps the capacity.
+    void run();
+  };
+
+  // Ring of buckets, oldest first, cookies increasing.
+  struct todo {
+    std::array<bucket, kBuckets> ring;
+    std::size_t first = 0;
+    std::size_t n = 0;
+
+    bucket& operator[](std::size_t i) { return ring[(first + i) % kBuckets]; }
+    bucket& bucket_for(counter_t cookie);
+    std::size_t size();
+    std::size_t bytes();
+  };
+
+  static void run_heads(rcu_head* h);
+
+  void uncount(std::size_t bytes);
+  void do_clean(todo& v, counter_t completed);
+  void do_steal_tasks(todo& v, std::vector<task>& here);
 
   static constexpr counter_t kNoTasks = std::numeric_limits<counter_t>::max();
   static constexpr counter_t kStealerDummy = kNoTasks - 1;
 
   tools::atomic<counter_t> oldest_unreclaimed_hint_{kNoTasks};
-  tools::owner_stealer<std::vector<task_entry>> todo_list_;
+  tools::owner_stealer<todo> todo_list_;
+  // Only touched by the owner.
+  std::size_t owner_bytes_ = 0;
+  tools::atomic<std::ptrdiff_t>* live_bytes_ = nullptr;
 };
 
-inline void rcu_tls_reclaimer::do_clean(std::vector<task_entry>& v,
-                                        counter_t current_gen) {
-  auto it = v.begin();
-  while (it != v.end() && it->first + 2 <= current_gen) {
-    it->second();
-    ++it;
+inline void rcu_tls_reclaimer::run_heads(rcu_head* h) {
+  while (h) {
+    // reclaim frees the head.
+    rcu_head* next = h->next;
+    h->reclaim(h);
+    h = next;
   }
-  v.erase(v.begin(), it);
-  oldest_unreclaimed_hint_.store(v.empty() ? kNoTasks : v.front().first,
-                            tools::memory_order_relaxed);
 }
 
-inline std::size_t rcu_tls_reclaimer::owner_reclaim(counter_t current_gen,
-                                                    task t) {
+inline void rcu_tls_reclaimer::bucket::push(rcu_head* h) {
+  h->next = nullptr;
+  if (last) {
+    last->next = h;
+  } else {
+    first = h;
+  }
+  last = h;
+  ++n_heads;
+}
+
+inline void rcu_tls_reclaimer::bucket::run() {
+  for (auto& t : tasks) t();
+  tasks.clear();
+  run_heads(std::exchange(first, nullptr));
+  last = nullptr;
+  n_heads = 0;
+  bytes = 0;
+}
+
+inline rcu_tls_reclaimer::bucket& rcu_tls_reclaimer::todo::bucket_for(
+    counter_t cookie) {
+  if (n == 0 || ((*this)[n - 1].cookie < cookie && n != kBuckets)) {
+    bucket& b = (*this)[n++];
+    b.cookie = cookie;
+    return b;
+  }
+  bucket& b = (*this)[n - 1];
+  b.cookie = std::max(b.cookie, cookie);
+  return b;
+}
+
+inline std::size_t rcu_tls_reclaimer::todo::size() {
+  std::size_t res = 0;
+  for (std::size_t i = 0; i != n; ++i) res += (*this)[i].size();
+  return res;
+}
+
+inline std::size_t rcu_tls_reclaimer::todo::bytes() {
+  std::size_t res = 0;
+  for (std::size_t i = 0; i != n; ++i) res += (*this)[i].bytes;
+  return res;
+}
+
+inline void rcu_tls_reclaimer::uncount(std::size_t bytes) {
+  if (live_bytes_ && bytes) {
+    live_bytes_->fetch_sub(static_cast<std::ptrdiff_t>(bytes),
+                           tools::memory_order_relaxed);
+  }
+}
+
+inline void rcu_tls_reclaimer::do_clean(todo& v, counter_t completed) {
+  while (v.n != 0 && v[0].cookie <= completed) {
+    std::size_t bytes = v[0].bytes;
+    v[0].run();
+    uncount(bytes);
+    v.first = (v.first + 1) % kBuckets;
+    --v.n;
+  }
+  oldest_unreclaimed_hint_.store(v.n == 0 ? kNoTasks : v[0].cookie,
+                                 tools::memory_order_relaxed);
+  owner_bytes_ = v.bytes();
+}
+
+inline std::size_t rcu_tls_reclaimer::owner_reclaim(counter_t cookie,
+                                                    counter_t completed,
+                                                    task t,
+                                                    std::size_t bytes) {
+  std::size_t remaining = 0;
+  todo_list_.owner_access([&](auto& v) {
+    bucket& b = v.bucket_for(cookie);
+    b.push(std::move(t));
+    b.bytes += bytes;
+    do_clean(v, completed);
+    remaining = v.size();
+  });
+  return remaining;
+}
+
+inline std::size_t rcu_tls_reclaimer::owner_reclaim(counter_t cookie,
+                                                    counter_t completed,
+                                                    rcu_head* head,
+                                                    std::size_t bytes) {
+  std::size_t remaining = 0;
+  todo_list_.owner_access([&](auto& v) {
+    bucket& b = v.bucket_for(cookie);
+    b.push(head);
+    b.bytes += bytes;
+    do_clean(v, completed);
+    remaining = v.size();
+  });
+  return remaining;
+}
+
+template <std::ranges::input_range R>
+std::size_t rcu_tls_reclaimer::owner_reclaim_bulk(counter_t cookie,
+                                                  counter_t completed,
+                                                  R&& tasks,
+                                                  std::size_t bytes_each) {
   std::size_t remaining = 0;
   todo_list_.owner_access([&](auto& v) {
-    v.push_back({current_gen, std::move(t)});
-    do_clean(v, current_gen);
+    bucket& b = v.bucket_for(cookie);
+    if constexpr (std::ranges::sized_range<R> &&
+                  std::convertible_to<std::ranges::range_reference_t<R>,
+                                      task>) {
+      tools::reserve_more(b.tasks, std::ranges::size(tasks));
+    }
+    for (auto&& t : tasks) {
+      b.push(std::forward<decltype(t)>(t));
+      b.bytes += bytes_each;
+    }
+    do_clean(v, completed);
     remaining = v.size();
   });
   return remaining;
 }
 
-inline std::size_t rcu_tls_reclaimer::clean_ready_tasks(counter_t current_gen) {
+inline std::size_t rcu_tls_reclaimer::clean_ready_tasks(counter_t completed) {
   std::size_t remaining = 0;
   todo_list_.owner_access([&](auto& v) {
-    do_clean(v, current_gen);
+    do_clean(v, completed);
     remaining = v.size();
   });
   return remaining;
@@ -107,10 +296,44 @@ rcu_tls_reclaimer::oldest_unreclaimed_hint() const {
   return v;
 }
 
-inline void rcu_tls_reclaimer::do_steal_tasks(std::vector<task_entry>& v,
+inline void rcu_tls_reclaimer::do_steal_tasks(todo& v,
                                               std::vector<task>& here) {
-  for (auto& [gen, t] : v) here.push_back(std::move(t));
-  v.clear();
+  bucket heads;
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i != v.n; ++i) {
+    bucket& b = v[i];
+    bytes += b.bytes;
+    if (here.empty()) {
+      here.swap(b.tasks);
+    } else {
+      here.insert(here.end(), std::make_move_iterator(b.tasks.begin()),
+                  std::make_move_iterator(b.tasks.end()));
+      b.tasks.clear();
+    }
+    if (b.first) {
+      if (heads.last) {
+        heads.last->next = b.first;
+      } else {
+        heads.first = b.first;
+      }
+      heads.last = b.last;
+    }
+    b.first = b.last = nullptr;
+    b.n_heads = 0;
+    b.bytes = 0;
+  }
+  v.first = v.n = 0;
+
+  if (heads.first || (live_bytes_ && bytes)) {
+    // Not this: the reclaimer can be gone by the time the task runs.
+    here.push_back(task([h = heads.first, c = live_bytes_, bytes] {
+      run_heads(h);
+      if (c && bytes) {
+        c->fetch_sub(static_cast<std::ptrdiff_t>(bytes),
+                     tools::memory_order_relaxed);
+      }
+    }));
+  }
 }
 
 inline bool rcu_tls_reclaimer::try_steal_tasks(std::vector<task>& here) {
@@ -0,0 +1,123 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#if !defined(TOOLS_RL_TEST) && (defined(__AVX2__) || defined(__AVX512F__))
+#include <immintrin.h>
+#endif
+
+namespace tools {
+
+/*
+ * The scan kernel of synchronize().
+ *
+ * Counters live in an array of n <= 64 reader slots, kStride bytes apart.
+ * Bit i of the result is set iff 0 < counter_i < desired, i.e. reader i
+ * entered before the generation advanced to `desired` and hasn't exited yet.
+ *
+ * 0 < cur < desired is one unsigned comparison: cur - 1 < desired - 1.
+ *
+ * The vector versions gather the counters with plain loads. On x86 every
+ * aligned 8 byte element of a gather is loaded atomically, which is all a
+ * relaxed load gives us, and there is nothing to do for the Relacy build.
+ * The compiler flags pick the version (add_benchmark builds with
+ * -march=native).
+ */
+
+template <std::size_t kStride>
+std::uint64_t lagging_readers_mask_scalar(const tools::atomic<std::uint64_t>* first,
+                                          std::size_t n, std::uint64_t desired) {
+  const auto* bytes = reinterpret_cast<const unsigned char*>(first);
+  std::uint64_t res = 0;
+  for (std::size_t i = 0; i != n; ++i) {
+    const auto* c =
+        reinterpret_cast<const tools::atomic<std::uint64_t>*>(bytes + i * kStride);
+    std::uint64_t cur = c->load(tools::memory_order_relaxed);
+    res |= static_cast<std::uint64_t>(cur - 1 < desired - 1) << i;
+  }
+  return res;
+}
+
+#if !defined(TOOLS_RL_TEST) && defined(__AVX512F__)
+
+template <std::size_t kStride>
+std::uint64_t lagging_readers_mask_simd(const tools::atomic<std::uint64_t>* first,
+                                        std::size_t n, std::uint64_t desired) {
+  static_assert(kStride % 8 == 0);
+  const auto* base = reinterpret_cast<const long long*>(first);
+  constexpr long long s = static_cast<long long>(kStride / 8);
+  const __m512i index = _mm512_setr_epi64(0, s, 2 * s, 3 * s, 4 * s, 5 * s,
+                                          6 * s, 7 * s);
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i limit = _mm512_set1_epi64(static_cast<long long>(desired - 1));
+
+  std::uint64_t res = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    // The masked form only because gcc 12 warns about the unmasked one.
+    __m512i cur = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF,
+                                              index, base + i * s, 8);
+    __mmask8 m = _mm512_cmplt_epu64_mask(_mm512_sub_epi64(cur, one), limit);
+    res |= static_cast<std::uint64_t>(m) << i;
+  }
+  if (i != n) {
+    res |= lagging_readers_mask_scalar<kStride>(
+               reinterpret_cast<const tools::atomic<std::uint64_t>*>(base + i * s),
+               n - i, desired)
+           << i;
+  }
+  return res;
+}
+
+#elif !defined(TOOLS_RL_TEST) && defined(__AVX2__)
+
+template <std::size_t kStride>
+std::uint64_t lagging_readers_mask_simd(const tools::atomic<std::uint64_t>* first,
+                                        std::size_t n, std::uint64_t desired) {
+  static_assert(kStride % 8 == 0);
+  const auto* base = reinterpret_cast<const long long*>(first);
+  constexpr long long s = static_cast<long long>(kStride / 8);
+  const __m256i index = _mm256_setr_epi64x(0, s, 2 * s, 3 * s);
+  const __m256i one = _mm256_set1_epi64x(1);
+  // No unsigned 64 bit compare in AVX2: flip the sign bits, compare signed.
+  const __m256i sign = _mm256_set1_epi64x(std::int64_t{1} << 63);
+  const __m256i limit = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<long long>(desired - 1)), sign);
+
+  std::uint64_t res = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i cur = _mm256_i64gather_epi64(base + i * s, index, 8);
+    __m256i x = _mm256_xor_si256(_mm256_sub_epi64(cur, one), sign);
+    int m = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(limit, x)));
+    res |= static_cast<std::uint64_t>(m) << i;
+  }
+  if (i != n) {
+    res |= lagging_readers_mask_scalar<kStride>(
+               reinterpret_cast<const tools::atomic<std::uint64_t>*>(base + i * s),
+               n - i, desired)
+           << i;
+  }
+  return res;
+}
+
+#else
+
+template <std::size_t kStride>
+std::uint64_t lagging_readers_mask_simd(const tools::atomic<std::uint64_t>* first,
+                                        std::size_t n, std::uint64_t desired) {
+  return lagging_readers_mask_scalar<kStride>(first, n, desired);
+}
+
+#endif
+
+}  // namespace tools
@@ -0,0 +1,151 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <utils.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace tools {
+
+/*
+ * A small pool of threads that run reclamation batches (destructors), so
+ * that freeing a big update doesn't happen on one thread.
+ *
+ * execute(f) runs f on some worker. execute_near(cpu, f) runs f on
+ * worker_for(cpu) = cpu * n / ncpus: each worker serves a contiguous range of
+ * cpus, which on the usual numbering keeps a worker within one NUMA node.
+ * With pin == true each worker is also bound to its range (to one cpu if
+ * there are more workers than cpus), so memory goes back to the allocator
+ * arenas / nodes it came from.
+ *
+ * executor() is a copyable handle for v2::rcu_domain (and anything else
+ * taking a tools::executor). The pool must outlive the users of the handle.
+ * The destructor runs what is still queued.
+ *
+ * Plain threads: not for Relacy tests.
+ */
+class reclaim_pool : nomove {
+ public:
+  using task = std::move_only_function<void()>;
+
+  struct executor_handle {
+    reclaim_pool* pool;
+
+    void execute(task f) { pool->execute(std::move(f)); }
+    void execute_near(int cpu, task f) { pool->execute_near(cpu, std::move(f)); }
+  };
+
+  explicit reclaim_pool(std::size_t workers, bool pin = false)
+      : workers_(workers == 0 ? 1 : workers), n_cpus_(cpus()) {
+    for (std::size_t w = 0; w != workers_.size(); ++w) {
+      workers_[w].thread = std::jthread([this, w, pin](std::stop_token stop) {
+        if (pin) pin_to_range(w);
+        run(workers_[w], stop);
+      });
+    }
+  }
+
+  ~reclaim_pool() {
+    for (auto& w : workers_) w.thread.request_stop();
+    for (auto& w : workers_) w.thread.join();
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+  void execute(task f) {
+    std::size_t w = next_.fetch_add(1, std::memory_order_relaxed);
+    push(workers_[w % workers_.size()], std::move(f));
+  }
+
+  void execute_near(int cpu, task f) {
+    if (cpu < 0) {
+      execute(std::move(f));
+      return;
+    }
+    push(workers_[worker_for(cpu)], std::move(f));
+  }
+
+  // cpu >= 0. cpus past the configured ones wrap around.
+  std::size_t worker_for(int cpu) const {
+    std::size_t c = static_cast<std::size_t>(cpu) % n_cpus_;
+    return c * workers_.size() / n_cpus_;
+  }
+
+  executor_handle executor() { return executor_handle{this}; }
+
+ private:
+  struct alignas(cache_line_size) worker {
+    std::mutex m;
+    std::condition_variable_any cv;
+    std::vector<task> queue;
+    std::jthread thread;
+  };
+
+  static std::size_t cpus() {
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    return n > 0 ? static_cast<std::size_t>(n) : 1;
+  }
+
+  void push(worker& w, task f) {
+    {
+      std::lock_guard _{w.m};
+      w.queue.push_back(std::move(f));
+    }
+    w.cv.notify_one();
+  }
+
+  // Runs batches until stopped and drained.
+  static void run(worker& w, std::stop_token stop) {
+    std::vector<task> batch;
+    while (true) {
+      {
+        std::unique_lock l{w.m};
+        w.cv.wait(l, stop, [&] { return !w.queue.empty(); });
+        if (w.queue.empty()) return;
+        batch.swap(w.queue);
+      }
+      for (auto& f : batch) f();
+      batch.clear();
+    }
+  }
+
+  // The cpus c with worker_for(c) == w.
+  void pin_to_range(std::size_t w) {
+    std::size_t n = workers_.size();
+    std::size_t first = (w * n_cpus_ + n - 1) / n;
+    std::size_t last = ((w + 1) * n_cpus_ + n - 1) / n;
+    if (first == last) {
+      first = w * n_cpus_ / n;
+      last = first + 1;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (std::size_t c = first; c != last; ++c) CPU_SET(c, &set);
+    // Best effort: cpus may be offline or outside our cgroup.
+    (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  std::vector<worker> workers_;
+  std::size_t n_cpus_;
+  std::atomic<std::size_t> next_{0};
+};
+
+}  // namespace tools
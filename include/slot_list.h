@@ -0,0 +1,133 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#pragma once
+
+#include <atomic_wrappers.h>
+#include <utils.h>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+namespace tools {
+
+/*
+ * A lock-free registry of per-thread slots, for the domains whose readers
+ * publish their state in a slot that writers scan.
+ *
+ * Slots live in blocks of 64 with an in_use bitmask: taking a slot is a CAS
+ * on the mask, giving it back an atomic and. Blocks are pushed onto a list
+ * and only freed with the slot_list, so a scan can walk them without a lock
+ * while readers come and go.
+ *
+ * BlockExtra is stored once per block, for state about a block's slots as
+ * a group (rcu_reading_subsystem keeps the leaves of its wait tree there).
+ * Scans that need it walk the blocks themselves, from head().
+ *
+ * A slot has to be back in its initial state when it's released: the next
+ * reader gets it as is, and a scan can read it at any time.
+ */
+
+struct no_block_extra {};
+
+template <typename Slot, typename BlockExtra = no_block_extra>
+class slot_list : nomove {
+ public:
+  struct block : nomove {
+    static constexpr std::size_t kSize = 64;
+
+    std::array<Slot, kSize> slots;
+    tools::atomic<std::uint64_t> in_use{0};
+    [[no_unique_address]] BlockExtra extra;
+    // Set before the block is published, never changes after.
+    block* next = nullptr;
+
+    Slot* try_acquire() {
+      std::uint64_t used = in_use.load(tools::memory_order_relaxed);
+      while (used != ~std::uint64_t{0}) {
+        std::uint64_t bit = std::uint64_t{1} << std::countr_one(used);
+        if (in_use.compare_exchange_weak(used, used | bit,
+                                         tools::memory_order_acquire,
+                                         tools::memory_order_relaxed)) {
+          return &slots[std::countr_zero(bit)];
+        }
+      }
+      return nullptr;
+    }
+
+    void release(const Slot* s) {
+      in_use.fetch_and(~bit_of(*s), tools::memory_order_release);
+    }
+
+    std::uint64_t bit_of(const Slot& s) const {
+      return std::uint64_t{1} << (&s - slots.data());
+    }
+  };
+
+  // The slot of one reader: acquired on construction, released on
+  // destruction.
+  class handle : nomove {
+   public:
+    explicit handle(slot_list& l) { std::tie(block_, slot_) = l.acquire(); }
+    ~handle() { block_->release(slot_); }
+
+    Slot& operator*() const { return *slot_; }
+    Slot* operator->() const { return slot_; }
+
+   private:
+    block* block_;
+    Slot* slot_;
+  };
+
+  slot_list() = default;
+  ~slot_list() {
+    auto* b = blocks_.load(tools::memory_order_acquire);
+    while (b) {
+      delete std::exchange(b, b->next);
+    }
+  }
+
+  // A free slot and its block, in a new block if they are all taken.
+  std::pair<block*, Slot*> acquire() {
+    block* head = blocks_.load(tools::memory_order_acquire);
+    for (auto* b = head; b; b = b->next) {
+      if (auto* s = b->try_acquire()) return {b, s};
+    }
+
+    auto* res = new block;
+    res->in_use.store(1, tools::memory_order_relaxed);
+    do {
+      res->next = head;
+    } while (!blocks_.compare_exchange_weak(head, res,
+                                            tools::memory_order_release,
+                                            tools::memory_order_acquire));
+    return {res, &res->slots[0]};
+  }
+
+  // The newest block, the others follow through next.
+  block* head() const { return blocks_.load(tools::memory_order_acquire); }
+
+  // Calls f for every slot in use. A slot acquired or released meanwhile may
+  // or may not be visited.
+  template <typename F>
+  void for_each(F f) const {
+    for (auto* b = head(); b; b = b->next) {
+      for (auto used = b->in_use.load(tools::memory_order_relaxed); used;
+           used &= used - 1) {
+        f(const_cast<const Slot&>(b->slots[std::countr_zero(used)]));
+      }
+    }
+  }
+
+ private:
+  tools::atomic<block*> blocks_{nullptr};
+};
+
+}  // namespace tools
@@ -6,10 +6,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
 #include <utility>
 
 namespace tools {
 
+// Not std::hardware_destructive_interference_size: that one is not ABI stable
+// and gcc warns about using it in headers.
+inline constexpr std::size_t cache_line_size = 64;
+
 struct nomove {
   nomove() = default;
   nomove(const nomove&) = delete;
@@ -18,6 +24,14 @@ struct nomove {
   nomove& operator=(nomove&&) = delete;
 };
 
+// Makes room for n more elements in v. Unlike reserve(v.size() + n) it
+// grows geometrically, so appending in a loop stays amortized O(1).
+template <typename V>
+void reserve_more(V& v, std::size_t n) {
+  if (v.capacity() - v.size() >= n) return;
+  v.reserve(std::max(v.size() + n, 2 * v.capacity()));
+}
+
 template <typename F>
 struct [[nodiscard]] scope_exit {
   F f_;
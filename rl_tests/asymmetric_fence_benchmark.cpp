@@ -0,0 +1,184 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include <benchmark/benchmark.h>
+
+#include "rcu_reading_subsystem.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*
+ * Costs that decide which asymmetric fence to use on a host:
+ *   BM_heavy_fence       - heavy fences while N reader threads run read
+ *                          sections until it's done. N = 0 is the fence
+ *                          alone, reader_enter_exit is the readers'
+ *                          throughput under the fences.
+ *   BM_enter_exit        - rcu_reading_subsystem::tls enter()/exit() per
+ *                          thread, with the real light fence of the process.
+ *   BM_read_guard        - the same through the implicit thread_local tls.
+ *   BM_synchronize       - synchronize() with N registered idle readers.
+ *   BM_synchronize_parked - synchronize() when N readers are still in their
+ *                          read sections after it gave up spinning: what the
+ *                          parked phase and its wakeups cost.
+ *
+ * The light fence is picked at startup, run with
+ * TOOLS_ASYMMETRIC_FENCE=membarrier|mprotect|seq_cst to compare.
+ */
+
+namespace {
+
+tools::rcu_reading_subsystem subsystem;
+
+int max_threads() {
+  return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// The readers loop until the fences are done: a fixed number of iterations
+// each would have them finish long before the first few fences.
+template <auto heavy_fence>
+void BM_heavy_fence(benchmark::State& state) {
+  std::atomic<bool> stop{false};
+  std::atomic<std::uint64_t> enter_exits{0};
+  std::vector<std::jthread> readers;
+  for (std::int64_t i = 0; i != state.range(0); ++i) {
+    readers.emplace_back([&] {
+      tools::rcu_reading_subsystem::tls tls{subsystem};
+      std::uint64_t n = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        tls.enter();
+        benchmark::ClobberMemory();
+        tls.exit();
+        ++n;
+      }
+      enter_exits.fetch_add(n, std::memory_order_relaxed);
+    });
+  }
+
+  for (auto _ : state) {
+    heavy_fence();
+  }
+  stop.store(true, std::memory_order_relaxed);
+  readers.clear();
+
+  state.counters["readers"] = static_cast<double>(state.range(0));
+  state.counters["reader_enter_exit"] =
+      benchmark::Counter(static_cast<double>(enter_exits.load()),
+                         benchmark::Counter::kIsRate);
+}
+
+void seq_cst_fence() { std::atomic_thread_fence(std::memory_order_seq_cst); }
+
+void BM_heavy_fence_membarrier(benchmark::State& state) {
+  if (!tools::detail::asymmetric_fence_available(
+          tools::asymmetric_fence_kind::membarrier)) {
+    state.SkipWithError("membarrier is not available");
+    return;
+  }
+  BM_heavy_fence<tools::asymmetric_thread_fence_heavy_membarrier>(state);
+}
+
+void BM_heavy_fence_mprotect(benchmark::State& state) {
+  if (!tools::detail::asymmetric_fence_available(
+          tools::asymmetric_fence_kind::mprotect)) {
+    state.SkipWithError("mprotect fence is not available");
+    return;
+  }
+  BM_heavy_fence<tools::asymmetric_thread_fence_heavy_mprotect>(state);
+}
+
+void BM_heavy_fence_seq_cst(benchmark::State& state) {
+  BM_heavy_fence<seq_cst_fence>(state);
+}
+
+void heavy_fence_readers(benchmark::internal::Benchmark* b) {
+  b->Arg(0)->RangeMultiplier(2)->Range(1, max_threads())->UseRealTime();
+}
+
+BENCHMARK(BM_heavy_fence_membarrier)->Apply(heavy_fence_readers);
+BENCHMARK(BM_heavy_fence_mprotect)->Apply(heavy_fence_readers);
+BENCHMARK(BM_heavy_fence_seq_cst)->Apply(heavy_fence_readers);
+
+void BM_enter_exit(benchmark::State& state) {
+  tools::rcu_reading_subsystem::tls tls{subsystem};
+  for (auto _ : state) {
+    tls.enter();
+    benchmark::ClobberMemory();
+    tls.exit();
+  }
+}
+BENCHMARK(BM_enter_exit)->ThreadRange(1, max_threads());
+
+void BM_enter_exit_nested(benchmark::State& state) {
+  tools::rcu_reading_subsystem::tls tls{subsystem};
+  tls.enter();
+  for (auto _ : state) {
+    tls.enter();
+    benchmark::ClobberMemory();
+    tls.exit();
+  }
+  tls.exit();
+}
+BENCHMARK(BM_enter_exit_nested);
+
+void BM_read_guard(benchmark::State& state) {
+  for (auto _ : state) {
+    tools::rcu_reading_subsystem::read_guard g{subsystem};
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_read_guard)->ThreadRange(1, max_threads());
+
+void BM_synchronize(benchmark::State& state) {
+  tools::rcu_reading_subsystem s;
+  std::vector<std::unique_ptr<tools::rcu_reading_subsystem::tls>> readers;
+  for (std::int64_t i = 0; i != state.range(0); ++i) {
+    readers.push_back(std::make_unique<tools::rcu_reading_subsystem::tls>(s));
+  }
+
+  for (auto _ : state) {
+    s.synchronize();
+  }
+  state.counters["readers"] = static_cast<double>(state.range(0));
+}
+BENCHMARK(BM_synchronize)->RangeMultiplier(4)->Range(1, 1 << 14);
+
+void BM_synchronize_parked(benchmark::State& state) {
+  tools::rcu_reading_subsystem s;
+  std::atomic<bool> stop{false};
+  std::vector<std::jthread> readers;
+  for (std::int64_t i = 0; i != state.range(0); ++i) {
+    readers.emplace_back([&] {
+      tools::rcu_reading_subsystem::tls tls{s};
+      while (!stop.load(std::memory_order_relaxed)) {
+        tls.enter();
+        // Hold the read section until a grace period waits for it, then
+        // some more so that it has to park.
+        auto g = s.generation();
+        while (s.generation() == g && !stop.load(std::memory_order_relaxed)) {
+          std::this_thread::yield();
+        }
+        for (int j = 0; j != 16; ++j) std::this_thread::yield();
+        tls.exit();
+      }
+    });
+  }
+
+  for (auto _ : state) {
+    s.synchronize();
+  }
+  stop.store(true, std::memory_order_relaxed);
+  s.synchronize();
+  state.counters["readers"] = static_cast<double>(state.range(0));
+}
+BENCHMARK(BM_synchronize_parked)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,143 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+// Plain threads, not Relacy: implicit readers are thread_local.
+
+#include "rcu_reading_subsystem.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#define CHECK(cond)                                                \
+  do {                                                             \
+    if (!(cond)) {                                                 \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      return false;                                                \
+    }                                                              \
+  } while (0)
+
+using subsystem = tools::rcu_reading_subsystem;
+
+// synchronize() waits for a read_guard, and for nested read_lock()s to all
+// be unlocked.
+bool synchronize_waits_for_implicit_reader() {
+  subsystem s;
+  std::atomic<int> step{0};
+  std::atomic<bool> synchronized{false};
+
+  std::jthread reader([&] {
+    s.read_lock();
+    {
+      subsystem::read_guard g{s};
+      step.store(1);
+      while (step.load() != 2) std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    step.store(3);
+    s.read_unlock();
+  });
+  while (step.load() != 1) std::this_thread::yield();
+
+  std::jthread writer([&] {
+    s.synchronize();
+    synchronized.store(true);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!synchronized.load());
+  step.store(2);
+  writer.join();
+  CHECK(step.load() == 3);
+  return true;
+}
+
+// One tls per subsystem and thread, whichever order they are used in, more
+// subsystems than the cache holds included.
+bool one_tls_per_subsystem_and_thread() {
+  std::array<subsystem, 7> ss;
+  std::array<subsystem::tls*, 7> first{};
+  for (std::size_t i = 0; i != ss.size(); ++i) {
+    first[i] = &ss[i].this_thread_tls();
+  }
+  for (int round = 0; round != 3; ++round) {
+    for (std::size_t i = 0; i < ss.size(); i += 1 + round) {
+      CHECK(&ss[i].this_thread_tls() == first[i]);
+      CHECK(&ss[0].this_thread_tls() == first[0]);
+    }
+  }
+  for (std::size_t i = 0; i != ss.size(); ++i) {
+    for (std::size_t j = 0; j != i; ++j) CHECK(first[i] != first[j]);
+  }
+
+  subsystem::tls* other = nullptr;
+  std::jthread{[&] { other = &ss[0].this_thread_tls(); }}.join();
+  CHECK(other != first[0]);
+  return true;
+}
+
+// A thread outliving subsystems it read from: a new one, possibly where the
+// old one was, gets its own tls. Dead ones are released along the way.
+bool thread_outlives_subsystems() {
+  subsystem kept;
+  subsystem::tls* kept_tls = &kept.this_thread_tls();
+
+  std::optional<subsystem> s;
+  for (int i = 0; i != 100; ++i) {
+    s.emplace();
+    subsystem::tls* t = &s->this_thread_tls();
+    CHECK(t != kept_tls);
+    {
+      subsystem::read_guard g{*s};
+      subsystem::read_guard k{kept};
+    }
+    s->synchronize();
+    s.reset();
+  }
+  CHECK(&kept.this_thread_tls() == kept_tls);
+  kept.synchronize();
+
+  // Threads exiting after their subsystem is gone.
+  std::vector<std::jthread> threads;
+  std::atomic<int> registered{0};
+  std::atomic<bool> exit{false};
+  {
+    subsystem gone;
+    for (int i = 0; i != 4; ++i) {
+      threads.emplace_back([&] {
+        subsystem::read_guard g{gone};
+        registered.fetch_add(1);
+      });
+    }
+    while (registered.load() != 4) std::this_thread::yield();
+    for (auto& t : threads) t.join();
+    threads.clear();
+    for (int i = 0; i != 4; ++i) {
+      threads.emplace_back([&] {
+        { subsystem::read_guard g{gone}; }
+        registered.fetch_add(1);
+        while (!exit.load()) std::this_thread::yield();
+      });
+    }
+    while (registered.load() != 8) std::this_thread::yield();
+  }
+  exit.store(true);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  return (synchronize_waits_for_implicit_reader()
+       && one_tls_per_subsystem_and_thread()
+       && thread_outlives_subsystems()) ? 0 : 1;
+}
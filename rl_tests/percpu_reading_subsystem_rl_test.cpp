@@ -0,0 +1,33 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include "relacy/context.hpp"
+#include "relacy/thread_local.hpp"
+#define TOOLS_RL_TEST
+#include "percpu_reading_subsystem.h"
+
+#include "rcu_rl_tests.h"
+
+// v1 on top of the per-cpu reader tracking.
+struct percpu_domain : tools::percpu_reading_subsystem {
+  using reader_tls = tools::percpu_reading_subsystem::tls;
+
+  struct reclaim_tls : tools::nomove {
+    percpu_domain* domain_;
+
+    explicit reclaim_tls(percpu_domain& d) : domain_(&d) {}
+
+    template <typename T, typename D = std::default_delete<T>>
+    void retire(T* x, D d = {}) {
+      domain_->synchronize();
+      d(x);
+    }
+  };
+
+  void barrier() { synchronize(); }
+};
+
+int main() { return full_test<percpu_domain>() ? 0 : 1; }
@@ -0,0 +1,74 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include "relacy/context.hpp"
+#include "relacy/thread_local.hpp"
+#define TOOLS_RL_TEST
+#include "qsbr_reading_subsystem.h"
+
+#include "rcu_rl_tests.h"
+
+// v1 on top of quiescent state tracking. The shared tests never call
+// quiescent_state(): a reader is done when its tls goes away.
+struct qsbr_domain : tools::qsbr_reading_subsystem {
+  using reader_tls = tools::qsbr_reading_subsystem::tls;
+
+  struct reclaim_tls : tools::nomove {
+    qsbr_domain* domain_;
+
+    explicit reclaim_tls(qsbr_domain& d) : domain_(&d) {}
+
+    template <typename T, typename D = std::default_delete<T>>
+    void retire(T* x, D d = {}) {
+      domain_->synchronize();
+      d(x);
+    }
+  };
+
+  void barrier() { synchronize(); }
+};
+
+// An event loop: reads, passes a quiescent state, blocks offline, reads
+// again. The writer replaces the config twice.
+template <typename Domain>
+struct qsbr_test_event_loop : rcu_test_base<qsbr_test_event_loop, Domain, 2> {
+  rl::atomic<const rl::var<int>*> config = 0;
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  int read() { return (*config.load(rl::memory_order_acquire))($); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    int val = read();
+    tls.quiescent_state();
+    int val2 = read();
+    tls.offline();
+    tls.online();
+    int val3 = read();
+    RL_ASSERT(1 <= val && val <= val2 && val2 <= val3 && val3 <= 3);
+  }
+
+  void thread_write() {
+    for (int i = 2; i <= 3; ++i) {
+      auto* old = config.exchange(new rl::var<int>(i), rl::memory_order_acq_rel);
+      this->synchronize();
+      delete old;
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx != 0) thread_read();
+    else thread_write();
+  }
+
+  void after() { delete config.load(rl::memory_order_acquire); }
+};
+
+int main() {
+  return (full_test<qsbr_domain>()
+       && simulate<qsbr_test_event_loop<qsbr_domain>>()) ? 0 : 1;
+}
@@ -12,4 +12,7 @@
 
 #include "rcu_rl_tests.h"
 
-int main() { return full_test<v1::rcu_domain>() ? 0 : 1; }
+int main() {
+  return (full_test<v1::rcu_domain>()
+       && async_test<v1::rcu_domain>()) ? 0 : 1;
+}
@@ -12,4 +12,14 @@
 
 #include "rcu_rl_tests.h"
 
-int main() { return full_test<v2::rcu_domain>() ? 0 : 1; }
+// Reclaims through the executor path: batches, counting, barrier waiting.
+struct rcu_v2_executor : v2::rcu_domain {
+  rcu_v2_executor() : v2::rcu_domain(tools::inline_executor{}) {}
+};
+
+int main() {
+  return (full_test<v2::rcu_domain>()
+       && full_test<rcu_v2_executor>()
+       && rcu_ptr_test<v2::rcu_domain>()
+       && simulate<rcu_test_retire_bulk<v2::rcu_domain>>()) ? 0 : 1;
+}
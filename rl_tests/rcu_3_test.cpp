@@ -30,8 +30,180 @@ struct rcu_v3_cfg_stale : v3::rcu_domain {
         }} {}
 };
 
+// Byte budgets far below the size hint: one retire is enough to reclaim.
+struct rcu_v3_thread_bytes : v3::rcu_domain {
+  rcu_v3_thread_bytes()
+      : v3::rcu_domain{v3::rcu_domain::config{
+            .retire_threshold = 100,
+            .retire_bytes_threshold = 1024,
+        }} {}
+};
+
+struct rcu_v3_domain_bytes : v3::rcu_domain {
+  rcu_v3_domain_bytes()
+      : v3::rcu_domain{v3::rcu_domain::config{
+            .retire_threshold = 100,
+            .domain_bytes_threshold = 1024,
+        }} {}
+};
+
+struct rcu_v3_memory_pressure : v3::rcu_domain {
+  rcu_v3_memory_pressure()
+      : v3::rcu_domain{v3::rcu_domain::config{
+            .retire_threshold = 1,
+            .memory_pressure = [] { return true; },
+        }} {}
+};
+
+// A big retire is reclaimed before retire() returns, under a reader.
+template <typename Domain>
+struct rcu_test_retire_bytes : rcu_test_base<rcu_test_retire_bytes, Domain, 2> {
+  rl::atomic<rl::var<int>*> config = 0;
+  rl::atomic<int> deleted{0};
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val = (*config.load(rl::memory_order_acquire))($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto tls = this->make_reclaim_tls();
+    auto* old = config.exchange(new rl::var<int>(2), rl::memory_order_acq_rel);
+    this->retire(
+        tls, old,
+        [this](rl::var<int>* p) {
+          deleted.fetch_add(1, rl::memory_order_relaxed);
+          delete p;
+        },
+        std::size_t{1} << 20);
+    RL_ASSERT(deleted.load(rl::memory_order_relaxed) == 1);
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else thread_read();
+  }
+
+  void after() {
+    this->barrier();
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
+// Same with retire_bulk(): the hint applies to each element.
+template <typename Domain>
+struct rcu_test_retire_bulk_bytes
+    : rcu_test_base<rcu_test_retire_bulk_bytes, Domain, 2> {
+  std::array<rl::atomic<rl::var<int>*>, 2> configs{nullptr, nullptr};
+  rl::atomic<int> deleted{0};
+
+  void before() {
+    for (auto& c : configs) {
+      c.store(new rl::var<int>(1), rl::memory_order_release);
+    }
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val0 = (*configs[0].load(rl::memory_order_acquire))($);
+    int val1 = (*configs[1].load(rl::memory_order_acquire))($);
+    tls.exit();
+    RL_ASSERT(val0 == 1 || val0 == 2);
+    RL_ASSERT(val1 == 1 || val1 == 2);
+  }
+
+  void thread_write() {
+    auto tls = this->make_reclaim_tls();
+    std::array<rl::var<int>*, 2> old;
+    for (std::size_t i = 0; i != 2; ++i) {
+      old[i] = configs[i].exchange(new rl::var<int>(2),
+                                   rl::memory_order_acq_rel);
+    }
+    rl::ctx().exec_log_msg($, "retire_bulk");
+    tls.retire_bulk(
+        old,
+        [this](rl::var<int>* p) {
+          deleted.fetch_add(1, rl::memory_order_relaxed);
+          delete p;
+        },
+        std::size_t{1} << 20);
+    RL_ASSERT(deleted.load(rl::memory_order_relaxed) == 2);
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else thread_read();
+  }
+
+  void after() {
+    this->barrier();
+    for (auto& c : configs) delete c.load(rl::memory_order_acquire);
+  }
+};
+
+struct intrusive_config : tools::rcu_head {
+  rl::var<int> value;
+
+  explicit intrusive_config(int v) : value(v) {}
+};
+
+// rcu_test_retire with the config retired through its rcu_head.
+template <typename Domain>
+struct rcu_test_retire_intrusive
+    : rcu_test_base<rcu_test_retire_intrusive, Domain, 3> {
+  rl::atomic<intrusive_config*> config = 0;
+
+  void before() {
+    config.store(new intrusive_config(1), rl::memory_order_release);
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val = config.load(rl::memory_order_acquire)->value($);
+    tls.exit();
+    RL_ASSERT(1 <= val && val <= 3);
+  }
+
+  void thread_write(unsigned idx) {
+    auto tls = this->make_reclaim_tls();
+    auto* upd = new intrusive_config(static_cast<int>(idx) + 2);
+    tls.retire_intrusive(config.exchange(upd, rl::memory_order_acq_rel));
+  }
+
+  void thread_(unsigned idx) {
+    if (idx < 2) thread_write(idx);
+    else thread_read();
+  }
+
+  void after() {
+    this->barrier();
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
 int main() {
   return (full_test<v3::rcu_domain>()
        && full_test<rcu_v3_small_cfg>()
-       && full_test<rcu_v3_cfg_stale>()) ? 0 : 1;
+       && full_test<rcu_v3_cfg_stale>()
+       && rcu_ptr_test<v3::rcu_domain>()
+       && rcu_ptr_test<rcu_v3_small_cfg>()
+       && simulate<rcu_test_retire_intrusive<v3::rcu_domain>>()
+       && simulate<rcu_test_retire_intrusive<rcu_v3_small_cfg>>()
+       && simulate<rcu_test_retire_bulk<v3::rcu_domain>>()
+       && simulate<rcu_test_retire_bulk<rcu_v3_small_cfg>>()
+       && simulate<rcu_test_retire_bytes<rcu_v3_thread_bytes>>()
+       && simulate<rcu_test_retire_bytes<rcu_v3_domain_bytes>>()
+       && simulate<rcu_test_retire_bytes<rcu_v3_memory_pressure>>()
+       && simulate<rcu_test_retire_bulk_bytes<rcu_v3_thread_bytes>>()
+       && simulate<rcu_test_retire_bulk_bytes<rcu_v3_domain_bytes>>()
+       && simulate<rcu_test_expedited<v3::rcu_domain>>()
+       && simulate<rcu_test_expedited_contended<v3::rcu_domain>>()
+       && full_test<rcu_v3_thread_bytes>()) ? 0 : 1;
 }
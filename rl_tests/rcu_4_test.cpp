@@ -0,0 +1,25 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include "relacy/context.hpp"
+#include "relacy/thread_local.hpp"
+#define TOOLS_RL_TEST
+#include "rcu_4.h"
+
+#include "rcu_rl_tests.h"
+
+// Tries to advance and reclaim on every retire.
+struct rcu_v4_eager : v4::rcu_domain {
+  rcu_v4_eager()
+      : v4::rcu_domain{v4::rcu_domain::config{
+            .retire_threshold = 1,
+        }} {}
+};
+
+int main() {
+  return (full_test<v4::rcu_domain>()
+       && full_test<rcu_v4_eager>()) ? 0 : 1;
+}
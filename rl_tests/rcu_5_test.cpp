@@ -0,0 +1,105 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include "relacy/context.hpp"
+#include "relacy/thread_local.hpp"
+#define TOOLS_RL_TEST
+#include "rcu_5.h"
+
+#include "rcu_rl_tests.h"
+
+// Scans as soon as the list has room for every hazard twice.
+struct rcu_v5_eager : v5::rcu_domain {
+  rcu_v5_eager()
+      : v5::rcu_domain{v5::rcu_domain::config{
+            .retire_threshold = 0,
+        }} {}
+};
+
+// Two writers replace and retire, a reader protects and reads.
+template <typename Domain>
+struct hp_test_protect : rcu_test_base<hp_test_protect, Domain, 3> {
+  rl::atomic<rl::var<int>*> config = 0;
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    auto* p = tls.protect(0, config);
+    int val = (*p)($);
+    tls.clear(0);
+    RL_ASSERT(1 <= val && val <= 3);
+  }
+
+  void thread_write(unsigned idx) {
+    auto tls = this->make_reclaim_tls();
+    auto* upd = new rl::var<int>(static_cast<int>(idx) + 2);
+    this->retire(tls, config.exchange(upd, rl::memory_order_acq_rel));
+  }
+
+  void thread_(unsigned idx) {
+    if (idx < 2) thread_write(idx);
+    else thread_read();
+  }
+
+  void after() {
+    this->barrier();
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
+// A reader holds on to one object while the writer retires a scan's worth:
+// everything but that object has to go.
+template <typename Domain>
+struct hp_test_stalled_reader
+    : rcu_test_base<hp_test_stalled_reader, Domain, 2> {
+  static constexpr int kRetires = 2 * Domain::kHazards;
+
+  rl::atomic<rl::var<int>*> config = 0;
+  rl::atomic<int> deleted{0};
+  rl::atomic<bool> done{false};
+
+  void before() { config.store(new rl::var<int>(0), rl::memory_order_release); }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) {
+      auto tls = this->make_reader_tls();
+      auto* p = tls.protect(0, config);
+      while (!done.load(rl::memory_order_acquire)) tools::this_thread_yield();
+      int val = (*p)($);
+      tls.clear(0);
+      RL_ASSERT(0 <= val && val <= kRetires);
+      return;
+    }
+
+    {
+      auto tls = this->make_reclaim_tls();
+      for (int i = 1; i <= kRetires; ++i) {
+        auto* old = config.exchange(new rl::var<int>(i), rl::memory_order_acq_rel);
+        this->retire(tls, old, [this](rl::var<int>* x) {
+          deleted.fetch_add(1, rl::memory_order_relaxed);
+          delete x;
+        });
+      }
+      RL_ASSERT(deleted.load(rl::memory_order_relaxed) >= kRetires - 1);
+    }
+    done.store(true, rl::memory_order_release);
+  }
+
+  void after() {
+    this->barrier();
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
+int main() {
+  return (simulate<rcu_test_retire_then_tls_death<v5::rcu_domain>>()
+       && simulate<rcu_test_cross_thread_reclaim<v5::rcu_domain>>()
+       && simulate<rcu_test_cross_thread_reclaim<rcu_v5_eager>>()
+       && simulate<hp_test_protect<v5::rcu_domain>>()
+       && simulate<hp_test_protect<rcu_v5_eager>>()
+       && simulate<hp_test_stalled_reader<rcu_v5_eager>>()) ? 0 : 1;
+}
@@ -13,9 +13,12 @@
 #include <relacy/var.hpp>
 
 #include "rl_simulate.h"
+#include "rcu_ptr.h"
 
 #include <array>
 #include <concepts>
+#include <coroutine>
+#include <exception>
 #include <format>
 #include <memory>
 
@@ -75,6 +78,15 @@ struct rcu_test_base
     rl::ctx().exec_log_msg(info, msg.c_str());
     tls.retire(ptr, d);
   }
+
+  template <typename Tls, typename T, typename D>
+  void retire(Tls& tls, T* ptr, D d, std::size_t bytes,
+              rl::debug_info_param info DEFAULTED_DEBUG_INFO) {
+    auto msg = std::format("retire({}, {} bytes)",
+                           static_cast<const void*>(ptr), bytes);
+    rl::ctx().exec_log_msg(info, msg.c_str());
+    tls.retire(ptr, d, bytes);
+  }
 };
 
 template <typename Domain>
@@ -409,10 +421,636 @@ struct rcu_test_nested_read : rcu_test_base<rcu_test_nested_read, Domain, 2> {
   }
 };
 
+// Reader re-registers between read sections, so the second tls may reuse
+// the slot the first one gave back while synchronize() is scanning.
+template <typename Domain>
+struct rcu_test_reregister : rcu_test_base<rcu_test_reregister, Domain, 3> {
+  std::array<rl::var<int>, 2> stages{0, 0};
+  rl::atomic<int> cur_stage = 0;
+
+  void before() { stages[0]($) = 1; }
+
+  void read_once() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int stage = cur_stage.load(rl::memory_order_acquire);
+    int val = stages[stage]($);
+    tls.exit();
+    RL_ASSERT(val == stage + 1);
+  }
+
+  void thread_write() {
+    stages[1]($) = 2;
+    cur_stage.store(1, rl::memory_order_release);
+    this->synchronize();
+    stages[0]($) = -1;
+  }
+
+  void thread_(unsigned idx) {
+    if (idx != 0) {
+      read_once();
+      read_once();
+    } else {
+      thread_write();
+    }
+  }
+};
+
+// Two writers synchronize at the same time and may share a grace period.
+// Each must still not free its old value under the reader.
+template <typename Domain>
+struct rcu_test_concurrent_sync
+    : rcu_test_base<rcu_test_concurrent_sync, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config0 = 0;
+  rl::atomic<const rl::var<int>*> config1 = 0;
+
+  auto& config(unsigned idx) { return idx == 0 ? config0 : config1; }
+
+  void before() {
+    config0.store(new rl::var<int>(1), rl::memory_order_release);
+    config1.store(new rl::var<int>(1), rl::memory_order_release);
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val0 = (*config0.load(rl::memory_order_acquire))($);
+    int val1 = (*config1.load(rl::memory_order_acquire))($);
+    tls.exit();
+    RL_ASSERT(val0 == 1 || val0 == 2);
+    RL_ASSERT(val1 == 1 || val1 == 2);
+  }
+
+  void thread_write(unsigned idx) {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config(idx).exchange(upd, rl::memory_order_acq_rel);
+    this->synchronize();
+    delete old;
+  }
+
+  void thread_(unsigned idx) {
+    if (idx < 2) thread_write(idx);
+    else thread_read();
+  }
+
+  void after() {
+    delete config0.load(rl::memory_order_acquire);
+    delete config1.load(rl::memory_order_acquire);
+  }
+};
+
 template <typename Domain>
 bool full_test() {
   return minimal_test<Domain>()
-      && simulate<rcu_test_nested_read<Domain>>();
+      && simulate<rcu_test_nested_read<Domain>>()
+      && simulate<rcu_test_reregister<Domain>>()
+      && simulate<rcu_test_concurrent_sync<Domain>>();
+}
+
+// Asynchronous grace periods: call_rcu / synchronize_async with a driver
+// thread calling process_grace_periods().
+
+template <typename Domain>
+struct rcu_test_call_rcu : rcu_test_base<rcu_test_call_rcu, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    this->domain.call_rcu([old] { delete old; });
+  }
+
+  void thread_drive() {
+    for (int i = 0; i != 3; ++i) {
+      this->domain.process_grace_periods();
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else if (idx == 1) thread_read();
+    else thread_drive();
+  }
+
+  void after() {
+    this->domain.call_rcu_barrier();
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
+// A callback calls call_rcu_barrier(): it runs the callbacks queued before
+// it itself instead of waiting for the runner, which is its own thread.
+template <typename Domain>
+struct rcu_test_call_rcu_nested_barrier
+    : rcu_test_base<rcu_test_call_rcu_nested_barrier, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+  rl::atomic<bool> queued{false};
+  rl::atomic<int> second_ran{0};
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    this->domain.call_rcu([this, old] {
+      delete old;
+      bool second_queued = queued.load(rl::memory_order_acquire);
+      this->domain.call_rcu_barrier();
+      if (second_queued) {
+        RL_ASSERT(second_ran.load(rl::memory_order_relaxed) == 1);
+      }
+    });
+    this->domain.call_rcu(
+        [this] { second_ran.store(1, rl::memory_order_relaxed); });
+    queued.store(true, rl::memory_order_release);
+  }
+
+  void thread_drive() {
+    for (int i = 0; i != 3; ++i) {
+      this->domain.process_grace_periods();
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else if (idx == 1) thread_read();
+    else thread_drive();
+  }
+
+  void after() {
+    this->domain.call_rcu_barrier();
+    RL_ASSERT(second_ran.load(rl::memory_order_relaxed) == 1);
+    delete config.load(rl::memory_order_acquire);
+  }
+};
+
+template <typename Domain>
+struct rcu_test_synchronize_async
+    : rcu_test_base<rcu_test_synchronize_async, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+  rl::atomic<bool> done{false};
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    auto c = this->domain.synchronize_async();
+    c.wait();
+    RL_ASSERT(c.ready());
+    done.store(true, rl::memory_order_relaxed);
+    delete old;
+  }
+
+  void thread_drive() {
+    while (!done.load(rl::memory_order_relaxed)) {
+      this->domain.process_grace_periods();
+      rl::yield(1, $);
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else if (idx == 1) thread_read();
+    else thread_drive();
+  }
+
+  void after() { delete config.load(rl::memory_order_acquire); }
+};
+
+// Fire and forget coroutine.
+struct rcu_test_coro {
+  struct promise_type {
+    rcu_test_coro get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// The writer coroutine suspends on the grace period and is resumed by the
+// driver thread, which then frees the old value.
+template <typename Domain>
+struct rcu_test_co_await : rcu_test_base<rcu_test_co_await, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+  rl::atomic<int> resumed{0};
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  rcu_test_coro update() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    co_await this->domain.grace_period();
+    delete old;
+    co_await this->domain.barrier_async();
+    resumed.store(1, rl::memory_order_release);
+  }
+
+  void thread_drive() {
+    while (!resumed.load(rl::memory_order_acquire)) {
+      this->domain.process_grace_periods();
+      rl::yield(1, $);
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) update();
+    else if (idx == 1) thread_read();
+    else thread_drive();
+  }
+
+  void after() { delete config.load(rl::memory_order_acquire); }
+};
+
+// The coroutine resumes inline on the driver thread, inside the callback
+// runner, and calls barrier() from there.
+template <typename Domain>
+struct rcu_test_co_await_barrier
+    : rcu_test_base<rcu_test_co_await_barrier, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+  rl::atomic<int> resumed{0};
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  rcu_test_coro update() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    co_await this->domain.grace_period();
+    this->barrier();
+    delete old;
+    this->domain.process_grace_periods();
+    resumed.store(1, rl::memory_order_release);
+  }
+
+  void thread_drive() {
+    while (!resumed.load(rl::memory_order_acquire)) {
+      this->domain.process_grace_periods();
+      rl::yield(1, $);
+    }
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) update();
+    else if (idx == 1) thread_read();
+    else thread_drive();
+  }
+
+  void after() { delete config.load(rl::memory_order_acquire); }
+};
+
+// The writer takes a cookie and frees the old value once a grace period
+// elapsed: either thread 1's synchronize() covered it or wait() runs one.
+template <typename Domain>
+struct rcu_test_cookie : rcu_test_base<rcu_test_cookie, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config = 0;
+
+  void before() { config.store(new rl::var<int>(1), rl::memory_order_release); }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded = config.load(rl::memory_order_acquire);
+    int val = (*loaded)($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto* upd = new rl::var<int>(2);
+    auto* old = config.exchange(upd, rl::memory_order_acq_rel);
+    auto cookie = this->domain.get_state();
+    if (!this->domain.poll(cookie)) this->domain.wait(cookie);
+    RL_ASSERT(this->domain.poll(cookie));
+    delete old;
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else if (idx == 1) this->synchronize();
+    else thread_read();
+  }
+
+  void after() { delete config.load(rl::memory_order_acquire); }
+};
+
+// An expedited and a normal writer at the same time, they may share
+// grace periods either way.
+template <typename Domain>
+struct rcu_test_expedited : rcu_test_base<rcu_test_expedited, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config0 = 0;
+  rl::atomic<const rl::var<int>*> config1 = 0;
+
+  void before() {
+    config0.store(new rl::var<int>(1), rl::memory_order_release);
+    config1.store(new rl::var<int>(1), rl::memory_order_release);
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val0 = (*config0.load(rl::memory_order_acquire))($);
+    int val1 = (*config1.load(rl::memory_order_acquire))($);
+    tls.exit();
+    RL_ASSERT(val0 == 1 || val0 == 2);
+    RL_ASSERT(val1 == 1 || val1 == 2);
+  }
+
+  void thread_write_expedited() {
+    auto* old = config0.exchange(new rl::var<int>(2), rl::memory_order_acq_rel);
+    this->domain.synchronize_expedited();
+    delete old;
+  }
+
+  void thread_write() {
+    auto* old = config1.exchange(new rl::var<int>(2), rl::memory_order_acq_rel);
+    this->synchronize();
+    delete old;
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write_expedited();
+    else if (idx == 1) thread_write();
+    else thread_read();
+  }
+
+  void after() {
+    delete config0.load(rl::memory_order_acquire);
+    delete config1.load(rl::memory_order_acquire);
+  }
+};
+
+// The reader stays in its read section until it's asked to hurry up, so the
+// normal grace period parks on it and the expedited caller has to get past
+// it.
+template <typename Domain>
+struct rcu_test_expedited_contended
+    : rcu_test_base<rcu_test_expedited_contended, Domain, 3> {
+  rl::atomic<const rl::var<int>*> config0 = 0;
+  rl::atomic<const rl::var<int>*> config1 = 0;
+
+  void before() {
+    config0.store(new rl::var<int>(1), rl::memory_order_release);
+    config1.store(new rl::var<int>(1), rl::memory_order_release);
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    const rl::var<int>* loaded0 = config0.load(rl::memory_order_acquire);
+    const rl::var<int>* loaded1 = config1.load(rl::memory_order_acquire);
+    for (int i = 0; i != 3 && !this->domain.expedite_requested(); ++i) {
+      rl::yield(1, $);
+    }
+    int val0 = (*loaded0)($);
+    int val1 = (*loaded1)($);
+    tls.exit();
+    RL_ASSERT(val0 == 1 || val0 == 2);
+    RL_ASSERT(val1 == 1 || val1 == 2);
+  }
+
+  void thread_write_expedited() {
+    auto* old = config0.exchange(new rl::var<int>(2), rl::memory_order_acq_rel);
+    this->domain.synchronize_expedited();
+    delete old;
+  }
+
+  void thread_write() {
+    auto* old = config1.exchange(new rl::var<int>(2), rl::memory_order_acq_rel);
+    this->synchronize();
+    delete old;
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else if (idx == 1) thread_write_expedited();
+    else thread_read();
+  }
+
+  void after() {
+    delete config0.load(rl::memory_order_acquire);
+    delete config1.load(rl::memory_order_acquire);
+  }
+};
+
+template <typename Domain>
+bool async_test() {
+  return simulate<rcu_test_call_rcu<Domain>>()
+      && simulate<rcu_test_call_rcu_nested_barrier<Domain>>()
+      && simulate<rcu_test_synchronize_async<Domain>>()
+      && simulate<rcu_test_co_await<Domain>>()
+      && simulate<rcu_test_co_await_barrier<Domain>>()
+      && simulate<rcu_test_cookie<Domain>>()
+      && simulate<rcu_test_expedited<Domain>>()
+      && simulate<rcu_test_expedited_contended<Domain>>();
+}
+
+// retire_bulk: two configs replaced and retired together while a reader
+// reads both.
+template <typename Domain>
+struct rcu_test_retire_bulk : rcu_test_base<rcu_test_retire_bulk, Domain, 2> {
+  std::array<rl::atomic<rl::var<int>*>, 2> configs{nullptr, nullptr};
+  rl::atomic<int> deleted{0};
+
+  void before() {
+    for (auto& c : configs) {
+      c.store(new rl::var<int>(1), rl::memory_order_release);
+    }
+  }
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val0 = (*configs[0].load(rl::memory_order_acquire))($);
+    int val1 = (*configs[1].load(rl::memory_order_acquire))($);
+    tls.exit();
+    RL_ASSERT(val0 == 1 || val0 == 2);
+    RL_ASSERT(val1 == 1 || val1 == 2);
+  }
+
+  void thread_write() {
+    auto tls = this->make_reclaim_tls();
+    std::array<rl::var<int>*, 2> old;
+    for (std::size_t i = 0; i != 2; ++i) {
+      old[i] = configs[i].exchange(new rl::var<int>(2),
+                                   rl::memory_order_acq_rel);
+    }
+    rl::ctx().exec_log_msg($, "retire_bulk");
+    tls.retire_bulk(old, [this](rl::var<int>* p) {
+      deleted.fetch_add(1, rl::memory_order_relaxed);
+      delete p;
+    });
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else thread_read();
+  }
+
+  void after() {
+    this->barrier();
+    RL_ASSERT(deleted.load(rl::memory_order_relaxed) == 2);
+    for (auto& c : configs) delete c.load(rl::memory_order_acquire);
+  }
+};
+
+// tools::rcu_ptr: publish-and-retire through the cell.
+
+template <template <typename> class test, typename Domain,
+          rl::thread_id_t static_thread_count_param>
+struct rcu_ptr_test_base
+    : rcu_test_base<test, Domain, static_thread_count_param> {
+  tools::rcu_ptr<rl::var<int>, Domain> ptr;
+
+  void before() {
+    auto tls = this->make_reclaim_tls();
+    ptr.store(tls, std::make_unique<rl::var<int>>(1));
+  }
+
+  void after() {
+    {
+      auto tls = this->make_reclaim_tls();
+      ptr.store(tls, nullptr);
+    }
+    this->barrier();
+  }
+};
+
+template <typename Domain>
+struct rcu_test_ptr_store : rcu_ptr_test_base<rcu_test_ptr_store, Domain, 3> {
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val = (*this->ptr.load())($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto tls = this->make_reclaim_tls();
+    this->ptr.store(tls, std::make_unique<rl::var<int>>(2));
+    this->barrier();
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else thread_read();
+  }
+};
+
+// exchange() doesn't retire: the old value stays readable until the caller
+// retires it.
+template <typename Domain>
+struct rcu_test_ptr_exchange
+    : rcu_ptr_test_base<rcu_test_ptr_exchange, Domain, 3> {
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val = (*this->ptr.load())($);
+    tls.exit();
+    RL_ASSERT(val == 1 || val == 2);
+  }
+
+  void thread_write() {
+    auto tls = this->make_reclaim_tls();
+    auto* old = this->ptr.exchange(std::make_unique<rl::var<int>>(2));
+    int val = (*old)($);
+    RL_ASSERT(val == 1);
+    this->retire(tls, old);
+    this->barrier();
+  }
+
+  void thread_(unsigned idx) {
+    if (idx == 0) thread_write();
+    else thread_read();
+  }
+};
+
+template <typename Domain>
+struct rcu_test_ptr_update
+    : rcu_ptr_test_base<rcu_test_ptr_update, Domain, 3> {
+
+  void thread_read() {
+    auto tls = this->make_reader_tls();
+    tls.enter();
+    int val = (*this->ptr.load())($);
+    tls.exit();
+    RL_ASSERT(1 <= val && val <= 3);
+  }
+
+  void thread_write() {
+    auto reader = this->make_reader_tls();
+    auto reclaim = this->make_reclaim_tls();
+    this->ptr.update(reader, reclaim, [](const rl::var<int>* cur) {
+      int val = (*cur)($);
+      return std::make_unique<rl::var<int>>(val + 1);
+    });
+  }
+
+  void thread_(unsigned idx) {
+    if (idx < 2) thread_write();
+    else thread_read();
+  }
+
+  void after() {
+    int val = (*this->ptr.load())($);
+    RL_ASSERT(val == 3);
+    rcu_ptr_test_base<rcu_test_ptr_update, Domain, 3>::after();
+  }
+};
+
+template <typename Domain>
+bool rcu_ptr_test() {
+  return simulate<rcu_test_ptr_store<Domain>>()
+      && simulate<rcu_test_ptr_exchange<Domain>>()
+      && simulate<rcu_test_ptr_update<Domain>>();
 }
 
 #endif  // RCU_RL_TESTS_H
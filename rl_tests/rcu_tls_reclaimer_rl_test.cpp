@@ -15,7 +15,10 @@
 
 #include "rl_simulate.h"
 
-// Task added at gen G becomes ready only when current_gen >= G+2.
+#include <array>
+#include <ranges>
+
+// Task with cookie C becomes ready only when the completed state is >= C.
 struct reclaimer_owner_cleans : rl::test_suite<reclaimer_owner_cleans, 1> {
   tools::rcu_tls_reclaimer r;
   rl::var<int> executed{0};
@@ -23,18 +26,18 @@ struct reclaimer_owner_cleans : rl::test_suite<reclaimer_owner_cleans, 1> {
   void thread(unsigned) {
     RL_ASSERT(!r.oldest_unreclaimed_hint().has_value());
 
-    auto cnt = r.owner_reclaim(1, [this] { executed($) = 1; });
+    auto cnt = r.owner_reclaim(2, 0, [this] { executed($) = 1; });
     RL_ASSERT(cnt == 1);
     RL_ASSERT(executed($) == 0);
-    RL_ASSERT(r.oldest_unreclaimed_hint() == 1);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
 
-    cnt = r.clean_ready_tasks(2);
-    RL_ASSERT(cnt == 1);  // gen 1+2=3 > 2: not yet
+    cnt = r.clean_ready_tasks(1);
+    RL_ASSERT(cnt == 1);  // cookie 2 > 1: not yet
     RL_ASSERT(executed($) == 0);
-    RL_ASSERT(r.oldest_unreclaimed_hint() == 1);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
 
-    cnt = r.clean_ready_tasks(3);
-    RL_ASSERT(cnt == 0);  // gen 1+2=3 <= 3: ready
+    cnt = r.clean_ready_tasks(2);
+    RL_ASSERT(cnt == 0);  // cookie 2 <= 2: ready
     RL_ASSERT(executed($) == 1);
     RL_ASSERT(!r.oldest_unreclaimed_hint().has_value());
   }
@@ -46,29 +49,29 @@ struct reclaimer_inline_clean : rl::test_suite<reclaimer_inline_clean, 1> {
   rl::var<int> t1_done{0}, t2_done{0};
 
   void thread(unsigned) {
-    r.owner_reclaim(1, [this] { t1_done($) = 1; });
-    auto cnt = r.owner_reclaim(3, [this] { t2_done($) = 1; });
-    RL_ASSERT(t1_done($) == 1);  // gen 1+2=3 <= 3: cleaned inline
-    RL_ASSERT(t2_done($) == 0);  // gen 3+2=5 > 3: not yet
+    r.owner_reclaim(2, 0, [this] { t1_done($) = 1; });
+    auto cnt = r.owner_reclaim(4, 2, [this] { t2_done($) = 1; });
+    RL_ASSERT(t1_done($) == 1);  // cookie 2 <= 2: cleaned inline
+    RL_ASSERT(t2_done($) == 0);  // cookie 4 > 2: not yet
     RL_ASSERT(cnt == 1);
-    RL_ASSERT(r.oldest_unreclaimed_hint() == 3);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 4);
   }
 };
 
-// Three tasks at different gens; only the two earliest are ready at gen=4.
+// Three tasks with different cookies; only the two earliest are ready at 4.
 struct reclaimer_partial_clean : rl::test_suite<reclaimer_partial_clean, 1> {
   tools::rcu_tls_reclaimer r;
   rl::var<int> cleaned{0};
 
   void thread(unsigned) {
-    r.owner_reclaim(1, [this] { cleaned($) += 1; });
-    r.owner_reclaim(2, [this] { cleaned($) += 1; });
-    r.owner_reclaim(5, [this] { cleaned($) += 1; });
+    r.owner_reclaim(2, 0, [this] { cleaned($) += 1; });
+    r.owner_reclaim(4, 0, [this] { cleaned($) += 1; });
+    r.owner_reclaim(8, 0, [this] { cleaned($) += 1; });
 
     auto cnt = r.clean_ready_tasks(4);
-    RL_ASSERT(cnt == 1);         // gen 5 remains
-    RL_ASSERT(cleaned($) == 2);  // gen 1 and 2 cleaned
-    RL_ASSERT(r.oldest_unreclaimed_hint() == 5);
+    RL_ASSERT(cnt == 1);         // cookie 8 remains
+    RL_ASSERT(cleaned($) == 2);  // cookies 2 and 4 cleaned
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 8);
   }
 };
 
@@ -79,7 +82,7 @@ struct reclaimer_try_steal : rl::test_suite<reclaimer_try_steal, 2> {
 
   void thread(unsigned idx) {
     if (idx == 0) {
-      r.owner_reclaim(1,
+      r.owner_reclaim(2, 0,
                       [this] { executed.store(1, rl::memory_order_relaxed); });
     } else {
       std::vector<tools::rcu_tls_reclaimer::task> tasks;
@@ -87,7 +90,7 @@ struct reclaimer_try_steal : rl::test_suite<reclaimer_try_steal, 2> {
         r.try_steal_tasks(tasks);
         if (tasks.empty()) rl::yield(1, $);
       }
-      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 1);
+      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 2);
       for (auto& t : tasks) t();
     }
   }
@@ -106,7 +109,7 @@ struct reclaimer_steal_blocking : rl::test_suite<reclaimer_steal_blocking, 2> {
 
   void thread(unsigned idx) {
     if (idx == 0) {
-      r.owner_reclaim(1, [this] {
+      r.owner_reclaim(2, 0, [this] {
         executed.store(1, rl::memory_order_relaxed);
       });
       reclaim_started.store(true, rl::memory_order_relaxed);
@@ -114,23 +117,23 @@ struct reclaimer_steal_blocking : rl::test_suite<reclaimer_steal_blocking, 2> {
       while (!reclaim_started.load(rl::memory_order_relaxed)) rl::yield(1, $);
       std::vector<tools::rcu_tls_reclaimer::task> tasks;
       r.steal_tasks_blocking(tasks);
-      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 1);
+      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 2);
       for (auto& t : tasks) t();
       RL_ASSERT(executed.load(rl::memory_order_relaxed) == 1);
     }
   }
 };
 
-// Owner adds two tasks at the same generation; stealer tries once.
-// Either it stole both (oldest clears) or some remain (oldest preserved at gen=1).
+// Owner adds two tasks with the same cookie; stealer tries once.
+// Either it stole both (oldest clears) or some remain (oldest preserved at cookie=2).
 struct reclaimer_try_steal_oldest : rl::test_suite<reclaimer_try_steal_oldest, 2> {
   tools::rcu_tls_reclaimer r;
   std::vector<tools::rcu_tls_reclaimer::task> stolen;
 
   void thread(unsigned idx) {
     if (idx == 0) {
-      r.owner_reclaim(1, [] {});
-      r.owner_reclaim(1, [] {});
+      r.owner_reclaim(2, 0, [] {});
+      r.owner_reclaim(2, 0, [] {});
     } else {
       r.try_steal_tasks(stolen);
     }
@@ -138,14 +141,14 @@ struct reclaimer_try_steal_oldest : rl::test_suite<reclaimer_try_steal_oldest, 2
 
   void after() {
     if (stolen.size() == 2) {
-      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 1);
+      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 2);
     } else {
-      RL_ASSERT(r.oldest_unreclaimed_hint() == 1);
+      RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
     }
   }
 };
 
-// Owner adds two tasks at the same generation; stealer blocks until it can steal.
+// Owner adds two tasks with the same cookie; stealer blocks until it can steal.
 // If it stole both, oldest clears. If it stole some, the owner's subsequent
 // write to oldest_unreclaimed must not be overridden by the steal's clear.
 struct reclaimer_steal_blocking_oldest : rl::test_suite<reclaimer_steal_blocking_oldest, 2> {
@@ -154,8 +157,8 @@ struct reclaimer_steal_blocking_oldest : rl::test_suite<reclaimer_steal_blocking
 
   void thread(unsigned idx) {
     if (idx == 0) {
-      r.owner_reclaim(1, [] {});
-      r.owner_reclaim(1, [] {});
+      r.owner_reclaim(2, 0, [] {});
+      r.owner_reclaim(2, 0, [] {});
     } else {
       r.steal_tasks_blocking(stolen);
     }
@@ -163,11 +166,110 @@ struct reclaimer_steal_blocking_oldest : rl::test_suite<reclaimer_steal_blocking
 
   void after() {
     if (stolen.size() == 2) {
-      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 1);
+      RL_ASSERT(!r.oldest_unreclaimed_hint().has_value() || r.oldest_unreclaimed_hint() == 2);
+    } else {
+      RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
+    }
+  }
+};
+
+struct counted_head : tools::rcu_head {
+  rl::var<int>* cleaned = nullptr;
+
+  static void reclaim(tools::rcu_head* h) {
+    auto* self = static_cast<counted_head*>(h);
+    (*self->cleaned)($) += 1;
+  }
+};
+
+// Intrusive heads: one segment per cookie, and once they run out the newest
+// segment takes the newer cookie. Nothing runs early.
+struct reclaimer_intrusive_segments
+    : rl::test_suite<reclaimer_intrusive_segments, 1> {
+  tools::rcu_tls_reclaimer r;
+  rl::var<int> cleaned{0};
+  std::array<counted_head, 5> heads;
+
+  void thread(unsigned) {
+    for (auto& h : heads) {
+      h.cleaned = &cleaned;
+      h.reclaim = counted_head::reclaim;
+    }
+    r.owner_reclaim(2, 0, &heads[0]);
+    r.owner_reclaim(2, 0, &heads[1]);
+    r.owner_reclaim(4, 0, &heads[2]);
+    r.owner_reclaim(6, 0, &heads[3]);
+    auto cnt = r.owner_reclaim(8, 0, &heads[4]);  // merged into cookie 8
+    RL_ASSERT(cnt == 5);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
+
+    cnt = r.clean_ready_tasks(4);
+    RL_ASSERT(cnt == 2);
+    RL_ASSERT(cleaned($) == 3);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 8);
+
+    cnt = r.clean_ready_tasks(6);
+    RL_ASSERT(cnt == 2);  // heads[3] went with cookie 8
+    RL_ASSERT(cleaned($) == 3);
+
+    cnt = r.clean_ready_tasks(8);
+    RL_ASSERT(cnt == 0);
+    RL_ASSERT(cleaned($) == 5);
+    RL_ASSERT(!r.oldest_unreclaimed_hint().has_value());
+  }
+};
+
+// Owner mixes tasks and heads, stealer blocks and runs whatever it got.
+struct reclaimer_intrusive_steal
+    : rl::test_suite<reclaimer_intrusive_steal, 2> {
+  tools::rcu_tls_reclaimer r;
+  rl::var<int> cleaned{0};
+  std::array<counted_head, 2> heads;
+  std::vector<tools::rcu_tls_reclaimer::task> stolen;
+
+  void before() {
+    for (auto& h : heads) {
+      h.cleaned = &cleaned;
+      h.reclaim = counted_head::reclaim;
+    }
+  }
+
+  void thread(unsigned idx) {
+    if (idx == 0) {
+      r.owner_reclaim(2, 0, &heads[0]);
+      r.owner_reclaim(2, 0, [] {});
+      r.owner_reclaim(4, 0, &heads[1]);
     } else {
-      RL_ASSERT(r.oldest_unreclaimed_hint() == 1);
+      r.steal_tasks_blocking(stolen);
     }
   }
+
+  void after() {
+    // Whatever the stealer missed is still with the owner.
+    r.steal_tasks_blocking(stolen);
+    for (auto& t : stolen) t();
+    RL_ASSERT(cleaned($) == 2);
+  }
+};
+
+// A bulk of tasks shares one cookie, then cleans like a single task would.
+struct reclaimer_bulk : rl::test_suite<reclaimer_bulk, 1> {
+  tools::rcu_tls_reclaimer r;
+  rl::var<int> cleaned{0};
+
+  void thread(unsigned) {
+    auto tasks = std::views::iota(0, 3) | std::views::transform([this](int) {
+                   return tools::rcu_tls_reclaimer::task(
+                       [this] { cleaned($) += 1; });
+                 });
+    auto cnt = r.owner_reclaim_bulk(2, 0, tasks);
+    RL_ASSERT(cnt == 3);
+    RL_ASSERT(r.oldest_unreclaimed_hint() == 2);
+
+    cnt = r.owner_reclaim(4, 2, [this] { cleaned($) += 1; });
+    RL_ASSERT(cnt == 1);
+    RL_ASSERT(cleaned($) == 3);
+  }
 };
 
 int main() {
@@ -177,5 +279,8 @@ int main() {
        && simulate<reclaimer_try_steal>()
        && simulate<reclaimer_steal_blocking>()
        && simulate<reclaimer_try_steal_oldest>()
-       && simulate<reclaimer_steal_blocking_oldest>()) ? 0 : 1;
+       && simulate<reclaimer_steal_blocking_oldest>()
+       && simulate<reclaimer_intrusive_segments>()
+       && simulate<reclaimer_intrusive_steal>()
+       && simulate<reclaimer_bulk>()) ? 0 : 1;
 }
@@ -0,0 +1,73 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include <benchmark/benchmark.h>
+
+#include "reader_scan.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/*
+ * synchronize() scan kernel: scalar vs vector, as a function of the number
+ * of reader slots. Slots are laid out like rcu_reading_subsystem's: one
+ * counter per cache line, in blocks of 64.
+ * About a quarter of the readers are inside a read section that started
+ * before `desired`.
+ */
+
+namespace {
+
+struct alignas(tools::cache_line_size) slot {
+  std::atomic<std::uint64_t> counter{0};
+};
+
+constexpr std::uint64_t kDesired = 100;
+
+std::vector<slot> make_slots(std::size_t n) {
+  std::vector<slot> res(n);
+  std::mt19937 g(0);
+  std::uniform_int_distribution<std::uint64_t> d(0, 2 * kDesired);
+  for (auto& s : res) {
+    auto v = d(g);
+    s.counter.store(v % 2 ? 0 : v, std::memory_order_relaxed);
+  }
+  return res;
+}
+
+template <auto kernel>
+void BM_scan(benchmark::State& state) {
+  auto slots = make_slots(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    std::uint64_t lagging = 0;
+    for (std::size_t i = 0; i < slots.size(); i += 64) {
+      std::size_t n = std::min<std::size_t>(64, slots.size() - i);
+      lagging += std::popcount(kernel(&slots[i].counter, n, kDesired));
+    }
+    benchmark::DoNotOptimize(lagging);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_scan_scalar(benchmark::State& state) {
+  BM_scan<tools::lagging_readers_mask_scalar<sizeof(slot)>>(state);
+}
+BENCHMARK(BM_scan_scalar)->RangeMultiplier(4)->Range(16, 1 << 16);
+
+void BM_scan_simd(benchmark::State& state) {
+  BM_scan<tools::lagging_readers_mask_simd<sizeof(slot)>>(state);
+}
+BENCHMARK(BM_scan_simd)->RangeMultiplier(4)->Range(16, 1 << 16);
+
+}  // namespace
+
+BENCHMARK_MAIN();
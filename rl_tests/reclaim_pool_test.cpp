@@ -0,0 +1,136 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+// Plain threads, not Relacy: reclaim_pool runs real workers.
+
+#include "rcu_2.h"
+#include "reclaim_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#define CHECK(cond)                                                \
+  do {                                                             \
+    if (!(cond)) {                                                 \
+      std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      return false;                                                \
+    }                                                              \
+  } while (0)
+
+struct fire_and_forget {
+  struct promise_type {
+    fire_and_forget get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Tasks for cpus of one worker run on one thread, other workers' on others.
+bool execute_near_maps_cpus_to_workers() {
+  constexpr int kCpus = 64;
+  tools::reclaim_pool pool(4);
+
+  std::mutex m;
+  std::vector<std::thread::id> ran_on(kCpus);
+  std::atomic<int> done{0};
+  for (int cpu = 0; cpu != kCpus; ++cpu) {
+    pool.execute_near(cpu, [&, cpu] {
+      std::lock_guard _{m};
+      ran_on[cpu] = std::this_thread::get_id();
+      done.fetch_add(1);
+    });
+  }
+  while (done.load() != kCpus) std::this_thread::yield();
+
+  std::lock_guard _{m};
+  for (int a = 0; a != kCpus; ++a) {
+    CHECK(pool.worker_for(a) < pool.size());
+    CHECK(pool.worker_for(a) == pool.worker_for(a + kCpus * 8));
+    for (int b = 0; b != kCpus; ++b) {
+      bool same_worker = pool.worker_for(a) == pool.worker_for(b);
+      CHECK(same_worker == (ran_on[a] == ran_on[b]));
+    }
+  }
+  return true;
+}
+
+// The destructor runs what is still queued.
+bool destructor_drains_queue() {
+  std::atomic<int> ran{0};
+  {
+    tools::reclaim_pool pool(2);
+    for (int i = 0; i != 1000; ++i) {
+      pool.execute([&, i] {
+        if (i % 100 == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ran.fetch_add(1);
+      });
+    }
+  }
+  CHECK(ran.load() == 1000);
+  return true;
+}
+
+// v2::rcu_domain::barrier() returns only once the workers have run every
+// batch, barrier_async() resumes only then.
+bool domain_barrier_waits_for_workers() {
+  tools::reclaim_pool pool(3, /*pin*/ true);
+  v2::rcu_domain d(pool.executor());
+
+  std::atomic<int> freed{0};
+  auto slow_delete = [&](int* p) {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    delete p;
+    freed.fetch_add(1);
+  };
+
+  {
+    std::vector<std::jthread> writers;
+    for (int t = 0; t != 3; ++t) {
+      writers.emplace_back([&] {
+        v2::rcu_domain::reclaim_tls tls{d};
+        for (int i = 0; i != 100; ++i) tls.retire(new int(i), slow_delete);
+      });
+    }
+  }
+  d.background_task();
+  d.barrier();
+  CHECK(freed.load() == 300);
+
+  v2::rcu_domain::reclaim_tls tls{d};
+  for (int i = 0; i != 100; ++i) tls.retire(new int(i), slow_delete);
+  std::atomic<int> resumed_at{-1};
+  [](v2::rcu_domain& d, std::atomic<int>& freed,
+     std::atomic<int>& resumed_at) -> fire_and_forget {
+    co_await d.barrier_async();
+    resumed_at.store(freed.load());
+  }(d, freed, resumed_at);
+  while (resumed_at.load() == -1) {
+    d.process_grace_periods();
+    std::this_thread::yield();
+  }
+  CHECK(resumed_at.load() == 400);
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  return (execute_near_maps_cpus_to_workers()
+       && destructor_drains_queue()
+       && domain_barrier_waits_for_workers()) ? 0 : 1;
+}
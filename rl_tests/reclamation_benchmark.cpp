@@ -0,0 +1,182 @@
+// clang-format off
+// Copyright 2026 Denis Yaroshevskiy
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+// clang-format on
+
+#include <benchmark/benchmark.h>
+
+#include "rcu_2.h"
+#include "rcu_3.h"
+#include "rcu_4.h"
+#include "rcu_5.h"
+#include "reclaim_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/*
+ * Reclamation schemes on one read-mostly workload: a config pointer that
+ * a writer keeps replacing (exchange + retire) while readers read it in
+ * read sections (or, with hazard pointers, protect it).
+ *   BM_read   - read sections per measured reader, with one writer in the
+ *               background.
+ *   BM_update - exchange + retire on the measured writer, with range(0)
+ *               readers in the background. <Domain, true>: retire_intrusive.
+ *   BM_barrier_v2 - v2::rcu_domain::barrier() freeing 4 mailboxes of 64k
+ *               nodes each, on the calling thread (range(0) == 0) or on a
+ *               reclaim_pool of range(0) workers.
+ */
+
+namespace {
+
+struct config : tools::rcu_head {
+  explicit config(int v = 0) : value(v) {}
+
+  int value;
+};
+
+int max_threads() {
+  return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+template <typename Domain>
+struct workload {
+  Domain domain;
+  std::atomic<config*> current{new config{}};
+
+  ~workload() {
+    domain.barrier();
+    delete current.load();
+  }
+
+  void read(typename Domain::reader_tls& tls) {
+    if constexpr (requires { tls.enter(); }) {
+      tls.enter();
+      benchmark::DoNotOptimize(current.load(std::memory_order_acquire)->value);
+      tls.exit();
+    } else {
+      benchmark::DoNotOptimize(tls.protect(0, current)->value);
+      tls.clear(0);
+    }
+  }
+
+  void update(typename Domain::reclaim_tls& tls, int i) {
+    tls.retire(current.exchange(new config{i}, std::memory_order_acq_rel));
+  }
+
+  void update_intrusive(typename Domain::reclaim_tls& tls, int i) {
+    tls.retire_intrusive(
+        current.exchange(new config{i}, std::memory_order_acq_rel));
+  }
+};
+
+// Runs f(stop) on n threads until destroyed.
+class background {
+ public:
+  template <typename F>
+  background(int n, F f) {
+    for (int i = 0; i != n; ++i) threads_.emplace_back([this, f] { f(stop_); });
+  }
+
+  ~background() {
+    stop_.store(true);
+    threads_.clear();
+  }
+
+ private:
+  std::atomic<bool> stop_{false};
+  std::vector<std::jthread> threads_;
+};
+
+template <typename Domain>
+void BM_read(benchmark::State& state) {
+  static workload<Domain> w;
+
+  std::optional<background> writer;
+  if (state.thread_index() == 0) {
+    writer.emplace(1, [](const std::atomic<bool>& stop) {
+      typename Domain::reclaim_tls tls{w.domain};
+      for (int i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+        w.update(tls, i);
+      }
+    });
+  }
+
+  typename Domain::reader_tls tls{w.domain};
+  for (auto _ : state) {
+    w.read(tls);
+  }
+}
+
+template <typename Domain, bool kIntrusive = false>
+void BM_update(benchmark::State& state) {
+  workload<Domain> w;
+  {
+    background readers(static_cast<int>(state.range(0)),
+                       [&](const std::atomic<bool>& stop) {
+                         typename Domain::reader_tls tls{w.domain};
+                         while (!stop.load(std::memory_order_relaxed)) {
+                           w.read(tls);
+                         }
+                       });
+    typename Domain::reclaim_tls tls{w.domain};
+    int i = 0;
+    for (auto _ : state) {
+      if constexpr (kIntrusive) {
+        w.update_intrusive(tls, ++i);
+      } else {
+        w.update(tls, ++i);
+      }
+    }
+  }
+}
+
+struct node {
+  std::unique_ptr<int[]> payload = std::make_unique<int[]>(16);
+};
+
+void BM_barrier_v2(benchmark::State& state) {
+  constexpr int kMailboxes = 4;
+  constexpr int kNodes = 1 << 16;
+
+  std::optional<tools::reclaim_pool> pool;
+  if (state.range(0) != 0) pool.emplace(static_cast<std::size_t>(state.range(0)));
+  std::optional<v2::rcu_domain> domain;
+  if (pool) {
+    domain.emplace(pool->executor());
+  } else {
+    domain.emplace();
+  }
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    {
+      std::vector<std::unique_ptr<v2::rcu_domain::reclaim_tls>> tls;
+      for (int m = 0; m != kMailboxes; ++m) {
+        tls.push_back(std::make_unique<v2::rcu_domain::reclaim_tls>(*domain));
+        for (int i = 0; i != kNodes; ++i) tls.back()->retire(new node{});
+      }
+    }
+    state.ResumeTiming();
+    domain->barrier();
+  }
+}
+
+BENCHMARK(BM_read<v3::rcu_domain>)->ThreadRange(1, max_threads());
+BENCHMARK(BM_read<v4::rcu_domain>)->ThreadRange(1, max_threads());
+BENCHMARK(BM_read<v5::rcu_domain>)->ThreadRange(1, max_threads());
+BENCHMARK(BM_update<v3::rcu_domain>)->RangeMultiplier(2)->Range(0, max_threads());
+BENCHMARK_TEMPLATE(BM_update, v3::rcu_domain, true)
+    ->RangeMultiplier(2)->Range(0, max_threads());
+BENCHMARK(BM_update<v4::rcu_domain>)->RangeMultiplier(2)->Range(0, max_threads());
+BENCHMARK(BM_update<v5::rcu_domain>)->RangeMultiplier(2)->Range(0, max_threads());
+BENCHMARK(BM_barrier_v2)->Arg(0)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();